@@ -0,0 +1,63 @@
+/**
+ * @author: Ticks
+ * @email: ticks.cc@gmail.com
+ */
+
+#pragma once
+
+#include "3rdparty/json/nlohmann_json.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <functional>
+#include <string>
+
+namespace QLW::Bench
+{
+
+using Json = nlohmann::json;
+
+// 基准用例
+struct Case
+{
+    const char* name;
+    std::function<void()> run;
+};
+
+// 注册基准用例
+int Register(const char* name, std::function<void()> run);
+// 所有已注册的用例
+QList<Case>& Cases();
+
+// 执行一次并返回耗时(毫秒)
+template <typename F> double Measure(F&& func)
+{
+    QElapsedTimer timer;
+    timer.start();
+    func();
+    return double(timer.nsecsElapsed()) / 1e6;
+}
+
+// 记录一条结果
+void Report(const char* name, qsizetype n, double ms);
+// 记录多次采样的结果，输出 p50/p95/p99，extra 中的字段一并输出
+void Report(const std::string& name, qsizetype n, QList<double> samples,
+            const Json& extra = Json::object());
+// 所有结果
+Json& Results();
+
+// 当前进程的常驻内存(字节)，不支持的平台返回 0
+qint64 ResidentMemory();
+// 用例规模，可由 QLW_BENCH_SIZES 指定，如 "1000,10000,100000"
+QList<qsizetype> Sizes(const QList<qsizetype>& defaults);
+// 采样次数，可由 QLW_BENCH_ROUNDS 指定
+int Rounds(int defaults);
+
+} // namespace QLW::Bench
+
+// 定义基准用例
+#define QLW_BENCH(NAME)                                                        \
+    static void QLWBench_##NAME();                                             \
+    static const int QLWBenchReg_##NAME =                                      \
+        QLW::Bench::Register(#NAME, QLWBench_##NAME);                          \
+    static void QLWBench_##NAME()
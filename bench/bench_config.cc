@@ -0,0 +1,75 @@
+#include "bench.h"
+#include "common/config.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+namespace
+{
+
+using namespace QLW;
+
+// 生成包含 n 个组件独立配置的文件
+QString Generate(qsizetype n)
+{
+    Json cfg;
+    cfg["theme"] = "dark";
+    auto& widgets = cfg["widgets"];
+    for (qsizetype i = 0; i < n; ++i) {
+        widgets["widget_" + std::to_string(i)] = {
+            {"light_custom_qss", "QLabel { color: #232730; padding: 2px; }"},
+            {"dark_custom_qss",  "QLabel { color: #f5f5f5; padding: 2px; }"},
+            {"visible",          (i % 3) != 0                              },
+            {"geometry",         {0, int(i), 120, 24}                      },
+        };
+    }
+    auto path = QDir::temp().filePath(
+        QString("qlw_bench_config_%1.json").arg(n));
+    QFile file(path);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        const auto content = cfg.dump(4);
+        file.write(content.data(), qint64(content.size()));
+    }
+    return path;
+}
+
+// 按行读取到 QString 后再解析，作为对比
+Json ReadLines(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return {};
+    }
+    QTextStream ts(&file);
+    QString content;
+    while (!ts.atEnd()) {
+        content.append(ts.readLine());
+    }
+    return Json::parse(content.toStdString());
+}
+
+} // namespace
+
+// 大配置文件的加载耗时
+QLW_BENCH(config)
+{
+    const auto rounds = Bench::Rounds(10);
+    for (auto n : Bench::Sizes({1000, 10000, 100000})) {
+        const auto path = Generate(n);
+        const Bench::Json extra = {
+            {"bytes", QFileInfo(path).size()},
+        };
+
+        QList<double> lines;
+        QList<double> read;
+        for (int i = 0; i < rounds; ++i) {
+            lines.append(Bench::Measure([&] { Q_UNUSED(ReadLines(path)); }));
+            read.append(Bench::Measure([&] { Q_UNUSED(Config::read(path)); }));
+        }
+        Bench::Report("config/readline", n, lines, extra);
+        Bench::Report("config/read", n, read, extra);
+        QFile::remove(path);
+    }
+}
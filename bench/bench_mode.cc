@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "common/style_sheet.h"
+
+#include <QCoreApplication>
+#include <QLabel>
+#include <QScopedPointer>
+
+namespace
+{
+
+struct Mode
+{
+    const char* name;
+    bool app;
+    QLW::ThemeStrategy strategy;
+};
+
+} // namespace
+
+// 不同模式与切换策略下的主题切换耗时
+QLW_BENCH(mode)
+{
+    using namespace QLW;
+    auto manager = StyleSheetManager::instance();
+    const auto rounds = Bench::Rounds(4);
+    constexpr Mode modes[] = {
+        {"mode/widget",      false, ThemeStrategy::StyleSheet      },
+        {"mode/application", true,  ThemeStrategy::StyleSheet      },
+        {"mode/property",    false, ThemeStrategy::PropertySelector},
+    };
+
+    for (auto n : Bench::Sizes({1000, 10000})) {
+        for (const auto& mode : modes) {
+            QScopedPointer<QWidget> root(new QWidget());
+            root->resize(1200, 800);
+            for (qsizetype i = 0; i < n; ++i) {
+                auto label = new QLabel(root.get());
+                label->setGeometry(int(i % 100) * 12, int(i / 100) * 8, 12, 8);
+                LineStyleSheet<LineStyleSheetEnum::alert>::instance()->apply(
+                    label, Config::instance()->getTheme());
+            }
+            root->show();
+            QCoreApplication::processEvents();
+            manager->setApplicationMode(mode.app);
+            manager->setStrategy(mode.strategy);
+
+            QList<double> samples;
+            for (int i = 0; i < rounds; ++i) {
+                samples.append(Bench::Measure([] { toggleTheme(); }));
+            }
+            Bench::Report(mode.name, n, samples);
+        }
+    }
+    manager->setApplicationMode(false);
+    manager->setStrategy(ThemeStrategy::StyleSheet);
+}
@@ -0,0 +1,65 @@
+#include "bench.h"
+#include "common/style_sheet.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QScopedPointer>
+
+namespace
+{
+
+// 固定内容的样式，避免文件读取干扰
+class ConstStyleSheet : public QLW::StyleSheetBase
+{
+public:
+    QString stylePath(QLW::Theme theme = QLW::Theme::LIGHT) override
+    {
+        return "";
+    }
+    QString styleContent(QLW::Theme theme = QLW::Theme::LIGHT) override
+    {
+        return theme == QLW::Theme::DARK ? "QWidget { color: #f5f5f5; }"
+                                         : "QWidget { color: #232730; }";
+    }
+};
+
+} // namespace
+
+QLW_BENCH(registry)
+{
+    using namespace QLW;
+    auto manager = StyleSheetManager::instance();
+
+    for (qsizetype n : {1000, 10000, 100000}) {
+        QScopedPointer<QWidget> root(new QWidget());
+        QList<QWidget*> widgets;
+        widgets.reserve(n);
+        for (qsizetype i = 0; i < n; ++i) {
+            widgets.append(new QWidget(root.get()));
+        }
+
+        Bench::Report("registry/reg", n, Bench::Measure([&] {
+                          for (auto widget : widgets) {
+                              manager->reg(new ConstStyleSheet, widget);
+                          }
+                      }));
+        Bench::Report("registry/lookup", n, Bench::Measure([&] {
+                          for (auto widget : widgets) {
+                              Q_UNUSED(manager->item(widget));
+                          }
+                      }));
+        Bench::Report("registry/events", n, Bench::Measure([&] {
+                          QEvent event(QEvent::User);
+                          for (auto widget : widgets) {
+                              QCoreApplication::sendEvent(widget, &event);
+                          }
+                      }));
+        Bench::Report("registry/update", n,
+                      Bench::Measure([&] { manager->update(true); }));
+        Bench::Report("registry/deReg", n, Bench::Measure([&] {
+                          for (auto widget : widgets) {
+                              manager->deReg(widget);
+                          }
+                      }));
+    }
+}
@@ -0,0 +1,139 @@
+#include "bench.h"
+#include "common/style_sheet.h"
+#include "components/alert.h"
+
+#include <QCoreApplication>
+#include <QLabel>
+#include <QQueue>
+#include <QScopedPointer>
+
+namespace
+{
+
+using namespace QLW;
+
+// 组件树形状
+enum class Shape
+{
+    // 所有组件直接挂在根组件下
+    Flat,
+    // 每个组件最多 8 个子组件的平衡树
+    Nested,
+};
+
+// 每隔多少个组件插入一个 Alert
+constexpr qsizetype AlertStride = 100;
+
+struct Tree
+{
+    QScopedPointer<QWidget> root;
+    // 使用 setThemeStyleSheet 注册的组件
+    QList<QWidget*> labels;
+    qsizetype alerts{0};
+};
+
+// 构建组件树，Alert 在构造时自行注册
+void Build(Tree& tree, Shape shape, qsizetype n)
+{
+    tree.root.reset(new QWidget());
+    tree.root->resize(1200, 800);
+    tree.labels.reserve(n);
+
+    QQueue<QWidget*> parents;
+    parents.enqueue(tree.root.get());
+    qsizetype children = 0;
+    for (qsizetype i = 0; i < n; ++i) {
+        auto parent = tree.root.get();
+        if (shape == Shape::Nested) {
+            parent = parents.head();
+            if (++children == 8) {
+                parents.dequeue();
+                children = 0;
+            }
+        }
+        if (i % AlertStride == AlertStride - 1) {
+            new Alert("bench", "bench", parent);
+            ++tree.alerts;
+            continue;
+        }
+        auto label = new QLabel(parent);
+        label->setGeometry(int(i % 100) * 12, int(i / 100 % 100) * 8, 12, 8);
+        tree.labels.append(label);
+        parents.enqueue(label);
+    }
+}
+
+Theme Other()
+{
+    return Config::instance()->getTheme() == Theme::DARK ? Theme::LIGHT
+                                                         : Theme::DARK;
+}
+
+} // namespace
+
+// 主题切换延迟: 组件树形状 x 规模 x 立即/延迟更新
+QLW_BENCH(theme)
+{
+    auto manager = StyleSheetManager::instance();
+    // 预取依赖事件循环空闲，关闭以保证各轮结果可比
+    const auto prefetch = manager->isPrefetchEnabled();
+    manager->setPrefetchEnabled(false);
+    const auto rounds = Bench::Rounds(20);
+
+    for (auto shape : {Shape::Flat, Shape::Nested}) {
+        const std::string prefix =
+            shape == Shape::Flat ? "theme/flat" : "theme/nested";
+        for (auto n : Bench::Sizes({1000, 10000, 100000})) {
+            Tree tree;
+            Build(tree, shape, n);
+            tree.root->show();
+            QCoreApplication::processEvents();
+
+            // 只统计注册带来的内存，不含组件本身
+            const auto before = Bench::ResidentMemory();
+            const auto reg = Bench::Measure([&] {
+                for (auto label : tree.labels) {
+                    setThemeStyleSheet(
+                        label,
+                        LineStyleSheet<LineStyleSheetEnum::alert>::instance(),
+                        Config::instance()->getTheme());
+                }
+            });
+            const auto after = Bench::ResidentMemory();
+            const auto registered = qsizetype(tree.labels.size());
+            const Bench::Json extra = {
+                {"shape", shape == Shape::Flat ? "flat" : "nested"},
+                {"labels", registered},
+                {"alerts", tree.alerts},
+                {"bytes_per_widget",
+                 registered > 0 ? double(after - before) / registered : 0.0},
+            };
+            Bench::Report(prefix + "/register", n, {reg}, extra);
+
+            // 预热，使两个主题的文件缓存都已生成
+            toggleTheme();
+            toggleTheme();
+
+            QList<double> eager;
+            for (int i = 0; i < rounds; ++i) {
+                eager.append(Bench::Measure([] { toggleTheme(); }));
+            }
+            Bench::Report(prefix + "/eager", n, eager, extra);
+
+            // 延迟更新: 切换时只标记，绘制时再应用
+            QList<double> lazy;
+            QList<double> paint;
+            for (int i = 0; i < rounds; ++i) {
+                lazy.append(Bench::Measure([] {
+                    Config::instance()->setTheme(Other());
+                    updateStyleSheet(true);
+                }));
+                paint.append(
+                    Bench::Measure([&] { tree.root->repaint(); }));
+            }
+            Bench::Report(prefix + "/lazy", n, lazy, extra);
+            Bench::Report(prefix + "/lazy+paint", n, paint, extra);
+        }
+    }
+    manager->setPrefetchEnabled(prefetch);
+}
@@ -0,0 +1,188 @@
+#include "bench.h"
+#include "common/logger.h"
+#include "common/trace.h"
+
+#include <QApplication>
+#include <QFile>
+#include <QSysInfo>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+// windows.h 必须在 psapi.h 之前
+#include <psapi.h>
+#elif defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+namespace QLW::Bench
+{
+
+int Register(const char* name, std::function<void()> run)
+{
+    Cases().append({name, std::move(run)});
+    return int(Cases().size());
+}
+
+QList<Case>& Cases()
+{
+    static QList<Case> cases;
+    return cases;
+}
+
+Json& Results()
+{
+    static Json results = Json::array();
+    return results;
+}
+
+// 最近秩法计算百分位
+static double Percentile(const QList<double>& sorted, double p)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    auto rank = qsizetype(std::ceil(p / 100.0 * double(sorted.size())));
+    return sorted[std::clamp<qsizetype>(rank - 1, 0, sorted.size() - 1)];
+}
+
+void Report(const char* name, qsizetype n, double ms)
+{
+    Report(std::string(name), n, QList<double>{ms});
+}
+
+void Report(const std::string& name, qsizetype n, QList<double> samples,
+            const Json& extra)
+{
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (auto it : samples) {
+        total += it;
+    }
+
+    Json result = extra;
+    result["name"] = name;
+    result["n"] = n;
+    result["samples"] = samples.size();
+    result["mean_ms"] = samples.isEmpty() ? 0 : total / samples.size();
+    result["min_ms"] = samples.isEmpty() ? 0 : samples.first();
+    result["max_ms"] = samples.isEmpty() ? 0 : samples.last();
+    result["p50_ms"] = Percentile(samples, 50);
+    result["p95_ms"] = Percentile(samples, 95);
+    result["p99_ms"] = Percentile(samples, 99);
+    Results().push_back(std::move(result));
+
+    // 进度输出到 stderr，stdout 只输出 JSON
+    std::fprintf(stderr, "%-40s n=%-8lld p50=%10.3f ms\n", name.c_str(),
+                 (long long)n, Percentile(samples, 50));
+}
+
+qint64 ResidentMemory()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                             sizeof(counters))) {
+        return qint64(counters.WorkingSetSize);
+    }
+    return 0;
+#elif defined(Q_OS_LINUX)
+    // statm: size resident shared ...，单位为页
+    QFile file("/proc/self/statm");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    auto fields = file.readAll().split(' ');
+    if (fields.size() < 2) {
+        return 0;
+    }
+    return fields[1].toLongLong() * qint64(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+QList<qsizetype> Sizes(const QList<qsizetype>& defaults)
+{
+    const auto env = qEnvironmentVariable("QLW_BENCH_SIZES");
+    QList<qsizetype> sizes;
+    for (const auto& it : QStringView(env).split(',', Qt::SkipEmptyParts)) {
+        auto ok = false;
+        auto n = it.trimmed().toLongLong(&ok);
+        if (ok && n > 0) {
+            sizes.append(qsizetype(n));
+        }
+    }
+    return sizes.isEmpty() ? defaults : sizes;
+}
+
+int Rounds(int defaults)
+{
+    auto ok = false;
+    auto rounds = qEnvironmentVariableIntValue("QLW_BENCH_ROUNDS", &ok);
+    return ok && rounds > 0 ? rounds : defaults;
+}
+
+} // namespace QLW::Bench
+
+// 用法: qlw_bench [filter] [--out file.json] [--trace trace.json]
+int main(int argc, char** argv)
+{
+    // 无窗口环境下运行
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QLW::SetGlobalLogLevel(QLW::LogLevel::kWARN);
+    QApplication app(argc, argv);
+
+    // 可选参数: 只运行名称包含 filter 的用例，结果写入 --out 指定的文件，
+    // --trace 指定时记录追踪事件
+    QString filter;
+    QString out;
+    QString trace;
+    const auto args = QApplication::arguments();
+    for (qsizetype i = 1; i < args.size(); ++i) {
+        if (args[i] == "--out" && i + 1 < args.size()) {
+            out = args[++i];
+        } else if (args[i] == "--trace" && i + 1 < args.size()) {
+            trace = args[++i];
+        } else {
+            filter = args[i];
+        }
+    }
+
+    QLW::Tracer::instance()->setEnabled(!trace.isEmpty());
+    for (const auto& it : QLW::Bench::Cases()) {
+        if (!filter.isEmpty() && !QString(it.name).contains(filter)) {
+            continue;
+        }
+        std::fprintf(stderr, "[%s]\n", it.name);
+        it.run();
+    }
+
+    if (!trace.isEmpty() && !QLW::Tracer::instance()->save(trace)) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(trace));
+    }
+
+    QLW::Bench::Json doc;
+    doc["qt"] = qVersion();
+    doc["platform"] = QApplication::platformName().toStdString();
+    doc["os"] = QSysInfo::prettyProductName().toStdString();
+    doc["cpu"] = QSysInfo::currentCpuArchitecture().toStdString();
+    doc["results"] = QLW::Bench::Results();
+    const auto content = doc.dump(2);
+
+    if (out.isEmpty()) {
+        QLW::Println("{}", content);
+        return 0;
+    }
+    QFile file(out);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(out));
+        return 1;
+    }
+    file.write(content.data(), qint64(content.size()));
+    return 0;
+}
@@ -0,0 +1,11 @@
+target("qlw_bench")
+	set_languages("c++20")
+	add_rules("qt.console")
+	add_deps("qt_line_widgets_static")
+	add_frameworks("QtGui", "QtCore", "QtWidgets", "QtSvg")
+	add_cxxflags("/source-charset:utf-8", { tools = {"cl", "win32_msvc"}}, {force = true})
+	add_files("*.cc")
+	add_files("../widgets/res/resource.qrc")
+	if is_plat("windows") then
+		add_syslinks("psapi")
+	end
@@ -1,9 +1,9 @@
 #include "config.h"
+#include <QCoreApplication>
 #include <QFile>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QSaveFile>
-#include <QTextStream>
 #include <QtDebug>
 
 namespace QLW
@@ -16,9 +16,27 @@ Config::Config(const QString& path)
     : _path(path)
 {
     this->load();
+
+    _save_timer.setSingleShot(true);
+    connect(&_save_timer, &QTimer::timeout, this, &Config::saveAsync);
+    _save_pool.setMaxThreadCount(1);
+    // 单例不会析构，QCoreApplication 析构时写入等待中的修改，
+    // 与延迟保存何时开启、QCoreApplication 何时创建无关
+    qAddPostRoutine([] {
+        if (Config::Self != nullptr) {
+            Config::Self->flush();
+        }
+    });
 }
 
-Config::~Config() { this->save(); }
+Config::~Config()
+{
+    if (_save_delay >= 0) {
+        this->flush();
+    } else {
+        this->save();
+    }
+}
 
 Config* Config::instance(const QString& path)
 {
@@ -35,42 +53,131 @@ Config* Config::instance(const QString& path)
 
 void Config::load()
 {
-    QFile file(_path);
-    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream ts(&file);
-        QString content;
-        try {
-            while (!ts.atEnd()) {
-                content.append(ts.readLine());
-            }
-            _cfg = Json::parse(content.toStdString());
-        } catch (...) {
-            qCritical() << "load config error!";
+    auto cfg = Config::read(_path);
+    if (!cfg.has_value()) {
+        return;
+    }
+    _theme.store(parseTheme(*cfg), std::memory_order_relaxed);
+    this->publish(std::make_shared<const Json>(std::move(*cfg)));
+}
+
+void Config::publish(std::shared_ptr<const Json> cfg)
+{
+    {
+        QMutexLocker locker{&_cfg_mutex};
+        _cfg.swap(cfg);
+    }
+    // cfg 现在持有旧快照，可能是最后一个引用，在锁外释放
+}
+
+std::optional<Json> Config::read(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    try {
+        // 优先映射文件，不支持映射时一次读取
+        const auto size = file.size();
+        auto data = size > 0 ? file.map(0, size) : nullptr;
+        if (data != nullptr) {
+            auto begin = reinterpret_cast<const char*>(data);
+            return Json::parse(begin, begin + size);
         }
-        file.close();
+        const auto content = file.readAll();
+        return Json::parse(content.constBegin(), content.constEnd());
+    } catch (...) {
+        qCritical() << "load config error!";
     }
+    return std::nullopt;
 }
 
 void Config::save()
 {
-    QSaveFile file(_path);
+    // 等待后台写入，避免旧快照覆盖本次写入
+    _save_timer.stop();
+    _save_pool.waitForDone();
+    auto cfg = this->snapshot();
+    if (Config::write(_path, *cfg)) {
+        QMutexLocker locker{&_saved_mutex};
+        _saved = std::move(cfg);
+    }
+}
+
+void Config::setSaveDelay(int msec)
+{
+    _save_delay = msec;
+    if (msec < 0) {
+        this->flush();
+        return;
+    }
+    _save_timer.setInterval(msec);
+}
+
+void Config::flush()
+{
+    const auto pending = _save_timer.isActive();
+    _save_timer.stop();
+    // 先等待进行中的写入，之前写入失败时未记录快照，在此重试
+    _save_pool.waitForDone();
+    if (pending || _save_delay >= 0) {
+        this->saveAsync();
+    }
+    _save_pool.waitForDone();
+}
+
+void Config::modified()
+{
+    if (_save_delay < 0) {
+        return;
+    }
+    // 可能在其他线程中修改，计时器只在所属线程中启动
+    QMetaObject::invokeMethod(&_save_timer, qOverload<>(&QTimer::start));
+}
+
+void Config::saveAsync()
+{
+    auto cfg = this->snapshot();
+    {
+        QMutexLocker locker{&_saved_mutex};
+        if (cfg == _saved) {
+            return;
+        }
+    }
+    // 快照不会再被修改，序列化与写入都在后台线程中进行，
+    // 写入成功后才记录，失败时下次保存或 flush 重新写入
+    _save_pool.start([this, cfg = std::move(cfg)] {
+        if (Config::write(_path, *cfg)) {
+            QMutexLocker locker{&_saved_mutex};
+            _saved = cfg;
+        }
+    });
+}
+
+bool Config::write(const QString& path, const Json& cfg)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCritical() << "save config error!";
+        return false;
+    }
     try {
-        auto content = _cfg.dump(4);
-        file.write(content.data());
+        auto content = cfg.dump(4);
+        file.write(content.data(), qint64(content.size()));
     } catch (...) {
         qCritical() << "save config error!";
         file.cancelWriting();
     }
-    file.commit();
+    return file.commit();
 }
 
-Theme Config::getTheme() const
+Theme Config::parseTheme(const Json& cfg)
 {
     Theme theme = Theme::LIGHT;
-    if (_cfg.contains(THEME_KEY) && _cfg[THEME_KEY].is_string()) {
-        std::string t;
-        _cfg[THEME_KEY].get_to(t);
-        theme = (t == "dark") ? Theme::DARK : Theme::LIGHT;
+    auto it = cfg.find(THEME_KEY);
+    if (it != cfg.end() && it->is_string()) {
+        theme = (it->get_ref<const std::string&>() == "dark") ? Theme::DARK
+                                                              : Theme::LIGHT;
     }
     return theme;
 }
@@ -78,7 +185,8 @@ Theme Config::getTheme() const
 void Config::setTheme(Theme theme)
 {
     const char* t = (theme == Theme::DARK) ? "dark" : "light";
-    _cfg[THEME_KEY] = t;
+    // 主题缓存由 update 更新
+    this->update([t](Json& cfg) { cfg[THEME_KEY] = t; });
     emit on_ThemeChanged(theme);
 }
 
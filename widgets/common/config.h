@@ -6,7 +6,15 @@
 #pragma once
 
 #include "3rdparty/json/nlohmann_json.h"
+#include "3rdparty/magic_enum/magic_enum.hpp"
+#include <QMutex>
+#include <QMutexLocker>
 #include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <optional>
 
 namespace QLW
 {
@@ -20,6 +28,8 @@ enum Theme
     DARK,
     AUTO
 };
+// 主题数量
+inline constexpr auto ThemeCount = magic_enum::enum_count<Theme>();
 
 // 配置
 class Config : public QObject
@@ -33,18 +43,56 @@ signals:
 public:
     ~Config();
     static Config* instance(const QString& path = "config/config.json");
-    // 保存配置
+    // 保存配置，立即写入
     void save();
-    // 获取主题
-    Theme getTheme() const;
+    // 延迟保存: 修改后等待 msec 毫秒，期间的修改合并为一次后台写入，
+    // 小于 0 时关闭
+    void setSaveDelay(int msec);
+    [[nodiscard]] int saveDelay() const { return _save_delay; }
+    // 立即写入等待中的修改并等待后台写入完成，退出时自动调用
+    void flush();
+    // 获取主题，可在任意线程中调用
+    Theme getTheme() const { return _theme.load(std::memory_order_relaxed); }
     // 设置主题
     void setTheme(Theme theme);
 
-    Json operator()() { return _cfg; }
+    // 只读快照，可在任意线程中读取，不复制配置内容，
+    // 只在复制指针时短暂加锁，与写入者的修改过程互不阻塞
+    [[nodiscard]] std::shared_ptr<const Json> snapshot() const
+    {
+        QMutexLocker locker{&_cfg_mutex};
+        return _cfg;
+    }
+    // 修改配置: 复制当前快照，修改后发布为新快照，写入之间互斥，
+    // 同时从新快照中更新主题缓存
+    template <typename F> void update(F&& func)
+    {
+        QMutexLocker locker{&_mutex};
+        auto cfg = std::make_shared<Json>(*this->snapshot());
+        func(*cfg);
+        _theme.store(parseTheme(*cfg), std::memory_order_relaxed);
+        this->publish(std::move(cfg));
+        this->modified();
+    }
+    // 复制整个配置，只读时应使用 snapshot()
+    Json operator()() { return *this->snapshot(); }
+
+    // 读取并解析配置文件，直接解析 UTF-8 字节，失败时返回空
+    static std::optional<Json> read(const QString& path);
 
 private:
     explicit Config(const QString& path);
     void load();
+    // 发布新快照，旧快照在锁外释放
+    void publish(std::shared_ptr<const Json> cfg);
+    // 从配置内容中读取主题
+    static Theme parseTheme(const Json& cfg);
+    // 配置已修改，延迟保存开启时重新计时
+    void modified();
+    // 在后台线程中写入当前快照
+    void saveAsync();
+    // 原子写入配置文件
+    static bool write(const QString& path, const Json& cfg);
 
 private:
     static Config* Self;
@@ -54,8 +102,22 @@ private:
 private:
     // 配置文件路径
     QString _path;
-    // Json 配置内容
-    Json _cfg;
+    // Json 配置内容，发布后不再修改，_cfg_mutex 只保护指针本身
+    std::shared_ptr<const Json> _cfg{
+        std::make_shared<const Json>(Json::object())};
+    mutable QMutex _cfg_mutex;
+    // 写入者之间互斥
+    QMutex _mutex;
+    // 主题缓存，在 load 与 update 中更新
+    std::atomic<Theme> _theme{Theme::LIGHT};
+
+    // 延迟保存，单线程保证写入顺序
+    int _save_delay{-1};
+    QTimer _save_timer;
+    QThreadPool _save_pool;
+    // 最近一次成功写入的快照，未变化时不再写入，由后台线程更新
+    std::shared_ptr<const Json> _saved;
+    QMutex _saved_mutex;
 
 }; // class Config
 
@@ -1,16 +1,30 @@
 #include "style_sheet.h"
 
+#include <QAbstractEventDispatcher>
+#include <QApplication>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
 #include <QList>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QThreadPool>
+#include <algorithm>
+
+#include "trace.h"
 
 namespace QLW
 {
 
+#if defined(QLW_ENABLE_STATS)
+// 各阶段耗时，只在 GUI 线程中收集
+static StyleSheetStats Stats;
+#endif
+
 /*------------------- StyleSheetManager -------------------*/
 
 StyleSheetManager* StyleSheetManager::Self = nullptr;
+const char* StyleSheetManager::THEME_PROPERTY_KEY = "qlwTheme";
 
 StyleSheetManager::StyleSheetManager()
     : QObject()
@@ -31,41 +45,844 @@ StyleSheetManager* StyleSheetManager::instance()
     return StyleSheetManager::Self;
 }
 
-void StyleSheetManager::init() {}
+void StyleSheetManager::init()
+{
+    _slice_timer.setSingleShot(true);
+    _slice_timer.setInterval(0);
+    connect(&_slice_timer, &QTimer::timeout, this,
+            &StyleSheetManager::updateSlice);
+
+    _watch_timer.setSingleShot(true);
+    _watch_timer.setInterval(100);
+    connect(&_watch_timer, &QTimer::timeout, this,
+            &StyleSheetManager::reloadFiles);
+}
 
 void StyleSheetManager::reg(StyleSheetBase* source, QWidget* widget, bool reset)
 {
+    auto item = this->insert(widget);
+    if (item->source.isNull() || reset) {
+        this->unwatch(item);
+        item->source.reset(
+            new StyleSheetCompose({source, new CustomStyleSheet(widget)}));
+    } else {
+        item->source->add(source);
+    }
+    this->watch(item, source);
+    this->share(source);
+    this->schedulePrefetch();
+}
+
+void StyleSheetManager::reg(const QSharedPointer<ThemeBackend>& backend,
+                            QWidget* widget)
+{
+    auto item = this->insert(widget);
+    item->backend = backend;
+    item->backend_theme = -1;
+}
 
-    if (!_widgets.contains(widget)) {
-        connect(widget, &QWidget::destroyed, this,
-                [this](QObject* obj) { this->deReg((QWidget*)(obj)); });
-        StyleSheetManager::Item item{
-            new StyleSheetCompose({source, new CustomStyleSheet(widget)}),
-            new CustomStyleSheetWatcher, new LineStyleSheetWatcher};
-        widget->installEventFilter(item.custom_watcher.get());
-        widget->installEventFilter(item.line_watcher.get());
-        _widgets[widget] = item;
-        return;
+StyleSheetManager::Item* StyleSheetManager::insert(QWidget* widget)
+{
+    auto item = this->item(widget);
+    if (item != nullptr) {
+        return item;
     }
-    if (!reset) {
-        auto s =
-            dynamic_cast<StyleSheetCompose*>(_widgets[widget].source.get());
-        s->add(source);
+    connect(widget, &QWidget::destroyed, this,
+            [this](QObject* obj) { this->erase((QWidget*)(obj)); });
+
+    quint32 slot;
+    if (!_free_slots.isEmpty()) {
+        slot = _free_slots.takeLast();
     } else {
-        _widgets[widget].source.reset(
-            new StyleSheetCompose({source, new CustomStyleSheet(widget)}));
+        slot = quint32(_slots.size());
+        _slots.append(Slot{});
+        _lazy.resize(_slots.size());
     }
+    _slots[slot].index = quint32(_items.size());
+    _items.append(Item{widget, nullptr});
+    _item_slots.append(slot);
+    _index.insert(widget, slot);
+
+    widget->installEventFilter(this);
+    return &_items.last();
 }
 
 void StyleSheetManager::deReg(QWidget* widget)
 {
-    const auto it = _widgets.find(widget);
-    if (it != _widgets.end()) {
-        _widgets.erase(it);
+    if (!_index.contains(widget)) {
+        return;
+    }
+    disconnect(widget, &QWidget::destroyed, this, nullptr);
+    widget->removeEventFilter(this);
+    this->erase(widget);
+}
+
+void StyleSheetManager::erase(QWidget* widget)
+{
+    const auto it = _index.constFind(widget);
+    if (it == _index.constEnd()) {
+        return;
+    }
+    const auto slot = it.value();
+    _index.erase(it);
+    this->setLazy(slot, false);
+
+    // 与末尾交换后删除，保持存储连续
+    const auto index = _slots[slot].index;
+    this->unwatch(&_items[index]);
+    const auto last = quint32(_items.size() - 1);
+    if (index != last) {
+        _items[index] = std::move(_items[last]);
+        _item_slots[index] = _item_slots[last];
+        _slots[_item_slots[index]].index = index;
+    }
+    _items.removeLast();
+    _item_slots.removeLast();
+
+    ++_slots[slot].generation;
+    _free_slots.append(slot);
+}
+
+void StyleSheetManager::setLazy(quint32 slot, bool lazy)
+{
+    if (_lazy.testBit(slot) == lazy) {
+        return;
+    }
+    _lazy.setBit(slot, lazy);
+    _lazy_count += lazy ? 1 : -1;
+    _deferred += lazy ? 1 : 0;
+}
+
+StyleSheetManager::Handle StyleSheetManager::handle(QWidget* widget) const
+{
+    const auto it = _index.constFind(widget);
+    if (it == _index.constEnd()) {
+        return {};
+    }
+    return {it.value(), _slots[it.value()].generation};
+}
+
+StyleSheetManager::Item* StyleSheetManager::item(Handle handle)
+{
+    if (handle.slot >= quint32(_slots.size()) ||
+        _slots[handle.slot].generation != handle.generation) {
+        return nullptr;
+    }
+    return &_items[_slots[handle.slot].index];
+}
+
+StyleSheetManager::Item* StyleSheetManager::item(QWidget* widget)
+{
+    const auto it = _index.constFind(widget);
+    if (it == _index.constEnd()) {
+        return nullptr;
+    }
+    return &_items[_slots[it.value()].index];
+}
+
+bool StyleSheetManager::apply(QWidget* widget, Theme theme)
+{
+    QLW_TRACE_SCOPE("StyleSheetManager::apply", widget);
+    const auto it = _index.constFind(widget);
+    if (it == _index.constEnd()) {
+        return false;
+    }
+    this->setLazy(it.value(), false);
+    if (_app_mode && _app_dirty) {
+        this->applyApplicationStyleSheet(Config::instance()->getTheme());
+    }
+
+    // 应用过程中可能触发事件导致注册表变化，先取出后端
+    auto item = &_items[_slots[it.value()].index];
+    QSharedPointer<ThemeBackend> backend;
+    if (!item->backend.isNull() && item->backend_theme != int(theme)) {
+        backend = item->backend;
+        item->backend_theme = int(theme);
+    }
+
+    auto applied = false;
+    if (!item->source.isNull()) {
+        applied = this->applyStyleSheet(item, widget, theme);
+    }
+    if (!backend.isNull()) {
+        backend->applyTheme(widget, theme);
+        applied = true;
+    }
+    if (applied) {
+        ++_applied;
+    } else {
+        ++_skipped;
+    }
+    return applied;
+}
+
+bool StyleSheetManager::applyStyleSheet(Item* item, QWidget* widget,
+                                        Theme theme)
+{
+    const auto selector = _strategy == ThemeStrategy::PropertySelector;
+    const auto select = selector && item->theme != int(theme);
+    if (selector) {
+        item->theme = int(theme);
+    }
+
+    // 组合样式中的变量已被替换
+    // 哈希随组合结果缓存，预取命中时无需再遍历内容
+    QString qss;
+    quint64 hash = 0;
+    if (selector) {
+        qss = item->source->scopedContent(_app_mode);
+        hash = item->source->scopedHash(_app_mode);
+    } else {
+        qss = _app_mode ? item->source->localContent(theme)
+                        : item->source->styleContent(theme);
+        hash = item->source->contentHash(theme, _app_mode);
+    }
+    const auto changed = item->hash != hash;
+    // setStyleSheet 可能触发事件导致注册表变化，之后不再访问 item
+    item->hash = hash;
+
+    if (select) {
+        widget->setProperty(THEME_PROPERTY_KEY,
+                            theme == Theme::DARK ? "dark" : "light");
+    }
+    if (changed) {
+        QLW_STATS_SCOPE(Stats.set_style_sheet);
+        widget->setStyleSheet(qss);
+        return true;
     }
+    if (select) {
+        QLW_STATS_SCOPE(Stats.polish);
+        this->repolish(widget);
+        return true;
+    }
+    return false;
 }
 
-auto& StyleSheetManager::items() { return _widgets; }
+void StyleSheetManager::repolish(QWidget* widget)
+{
+    auto style = widget->style();
+    style->unpolish(widget);
+    style->polish(widget);
+    widget->update();
+    // 已注册的子组件会单独处理
+    for (auto child : widget->children()) {
+        if (child->isWidgetType() &&
+            !_index.contains(static_cast<QWidget*>(child))) {
+            this->repolish(static_cast<QWidget*>(child));
+        }
+    }
+}
+
+void StyleSheetManager::setStrategy(ThemeStrategy strategy)
+{
+    if (_strategy == strategy) {
+        return;
+    }
+    _strategy = strategy;
+    _app_dirty = true;
+    for (auto& it : _items) {
+        it.hash = 0;
+        it.theme = -1;
+        it.backend_theme = -1;
+    }
+    this->update();
+}
+
+void StyleSheetManager::update(bool lazy)
+{
+    this->cancelPrefetch();
+    _slice_timer.stop();
+    _pending.clear();
+    _pending_pos = 0;
+    _pending_urgent = 0;
+    _pending_theme = Config::instance()->getTheme();
+    if (_app_mode) {
+        this->applyApplicationStyleSheet(_pending_theme);
+    }
+
+    // 可见组件按 窗口层级 -> 可见面积 排序，不可见组件延迟到绘制时更新
+    auto active = QApplication::activeWindow();
+    for (qsizetype i = 0; i < _items.size(); ++i) {
+        auto widget = _items[i].widget;
+        const auto slot = _item_slots[i];
+        auto region = lazy ? QRegion() : widget->visibleRegion();
+        if (region.isNull()) {
+            this->setLazy(slot, true);
+            continue;
+        }
+        qint64 area = 0;
+        for (const auto& rect : region) {
+            area += qint64(rect.width()) * rect.height();
+        }
+        auto rank = (widget->window() == active) ? 0 : 1;
+        _pending_urgent += (rank == 0) ? 1 : 0;
+
+        _pending.append(
+            Pending{Handle{slot, _slots[slot].generation}, rank, area});
+    }
+    std::sort(_pending.begin(), _pending.end(),
+              [](const Pending& lhs, const Pending& rhs) {
+                  if (lhs.rank != rhs.rank) {
+                      return lhs.rank < rhs.rank;
+                  }
+                  if (lhs.area != rhs.area) {
+                      return lhs.area > rhs.area;
+                  }
+                  return lhs.handle.slot < rhs.handle.slot;
+              });
+    this->updateSlice();
+}
+
+void StyleSheetManager::updateSlice()
+{
+    QLW_TRACE_SCOPE("StyleSheetManager::updateSlice");
+    QElapsedTimer elapsed;
+    elapsed.start();
+    const auto budget = qint64(_budget) * 1000 * 1000;
+
+    QList<QWidget*> removes;
+    while (_pending_pos < _pending.size()) {
+        // 分片之间组件可能已被注销
+        auto item = this->item(_pending[_pending_pos++].handle);
+        if (item == nullptr) {
+            continue;
+        }
+        auto widget = item->widget;
+
+        try {
+            this->apply(widget, _pending_theme);
+        } catch (...) {
+            removes.append(widget);
+        }
+
+        // 当前窗口的可见组件在首个分片内全部完成
+        if (budget > 0 && _pending_pos >= _pending_urgent &&
+            elapsed.nsecsElapsed() >= budget) {
+            break;
+        }
+    }
+    for (auto it : removes) {
+        this->deReg(it);
+    }
+
+    const auto total = int(_pending.size());
+    emit on_UpdateProgress(int(_pending_pos), total);
+    if (_pending_pos < _pending.size()) {
+        _slice_timer.start();
+        return;
+    }
+    _pending.clear();
+    _pending_pos = 0;
+    emit on_UpdateFinished();
+    QLW_STATS(emit on_StatsUpdated(this->stats()));
+    this->schedulePrefetch();
+}
+
+StyleSheetStats StyleSheetManager::stats() const
+{
+    StyleSheetStats stats;
+    QLW_STATS(stats = Stats);
+    stats.registered = _items.size();
+    for (const auto& it : _items) {
+        if (!it.source.isNull()) {
+            stats.composed_bytes += it.source->composedBytes();
+        }
+    }
+    stats.applied = _applied;
+    stats.skipped = _skipped;
+    stats.deferred = _deferred;
+    return stats;
+}
+
+void StyleSheetManager::resetStats()
+{
+    _applied = 0;
+    _skipped = 0;
+    _deferred = 0;
+    QLW_STATS(Stats = StyleSheetStats());
+}
+
+void StyleSheetManager::setPrefetchEnabled(bool enable)
+{
+    _prefetch = enable;
+    if (enable) {
+        this->schedulePrefetch();
+    } else {
+        this->cancelPrefetch();
+    }
+}
+
+void StyleSheetManager::cancelPrefetch()
+{
+    disconnect(_prefetch_idle);
+    if (!_prefetch_cancel.isNull()) {
+        _prefetch_cancel->storeRelaxed(1);
+        _prefetch_cancel.reset();
+    }
+}
+
+void StyleSheetManager::schedulePrefetch()
+{
+    if (!_prefetch || _strategy == ThemeStrategy::PropertySelector ||
+        _prefetch_idle) {
+        return;
+    }
+    auto dispatcher = QAbstractEventDispatcher::instance(this->thread());
+    if (dispatcher == nullptr) {
+        return;
+    }
+    // 事件循环处理完所有待处理事件、即将阻塞等待时开始，只触发一次
+    _prefetch_idle =
+        connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, this,
+                [this]() {
+                    disconnect(_prefetch_idle);
+                    this->startPrefetch();
+                });
+}
+
+void StyleSheetManager::startPrefetch()
+{
+    // 属性选择策略的样式已包含所有主题，无需预取
+    if (!_prefetch || _strategy == ThemeStrategy::PropertySelector ||
+        this->isUpdating()) {
+        return;
+    }
+    this->cancelPrefetch();
+
+    struct Job
+    {
+        QSharedPointer<StyleSheetCompose> source;
+        StyleSheetCompose::Snapshot snapshot;
+        QString content;
+        quint64 hash{0};
+    };
+
+    const auto current = Config::instance()->getTheme();
+    const auto theme = current == Theme::DARK ? Theme::LIGHT : Theme::DARK;
+    // 另一个主题已保留的结果(之前的预取或切换前的主题)同样计入预算，
+    // 超出部分释放，可见组件优先保留
+    qsizetype used = 0;
+    for (auto visible : {true, false}) {
+        for (const auto& it : _items) {
+            if (it.source.isNull() || it.widget->isVisible() != visible) {
+                continue;
+            }
+            const auto bytes = it.source->composedBytes(theme, false) +
+                               it.source->composedBytes(theme, true);
+            if (used + bytes > _prefetch_budget) {
+                it.source->release(theme);
+                continue;
+            }
+            used += bytes;
+        }
+    }
+
+    // 在 GUI 线程中创建快照，可见组件优先，
+    // 以当前主题的组合结果估算大小，预计超出预算时停止，
+    // 当前主题尚未组合(隐藏或等待绘制)的组件无法估算，不预取
+    QList<Job> jobs;
+    auto estimate = used;
+    for (auto visible : {true, false}) {
+        for (const auto& it : _items) {
+            if (it.source.isNull() || it.widget->isVisible() != visible ||
+                it.source->isComposed(theme, _app_mode) ||
+                !it.source->isComposed(current, _app_mode)) {
+                continue;
+            }
+            estimate += it.source->composedBytes(current, _app_mode);
+            if (estimate > _prefetch_budget) {
+                break;
+            }
+            jobs.append(Job{it.source, it.source->snapshot(theme, _app_mode),
+                            QString(), 0});
+        }
+        if (estimate > _prefetch_budget) {
+            break;
+        }
+    }
+    if (jobs.isEmpty()) {
+        return;
+    }
+
+    auto cancel = QSharedPointer<QAtomicInt>::create(0);
+    _prefetch_cancel = cancel;
+    const auto budget = _prefetch_budget - used;
+    QThreadPool::globalInstance()->start([this, jobs, cancel,
+                                          budget]() mutable {
+        qsizetype bytes = 0;
+        qsizetype done = 0;
+        for (auto& job : jobs) {
+            if (cancel->loadRelaxed() != 0) {
+                return;
+            }
+            job.content = StyleSheetCompose::render(job.snapshot);
+            bytes += job.content.size() * qsizetype(sizeof(QChar));
+            if (bytes > budget) {
+                break;
+            }
+            job.hash = getStyleSheetHash(job.content);
+            ++done;
+        }
+        jobs.resize(done);
+
+        // 结果在 GUI 线程中写入
+        QMetaObject::invokeMethod(
+            this,
+            [this, jobs, cancel]() {
+                if (cancel->loadRelaxed() != 0) {
+                    return;
+                }
+                auto count = 0;
+                for (const auto& job : jobs) {
+                    count += job.source->prime(job.snapshot, job.content,
+                                               job.hash)
+                                 ? 1
+                                 : 0;
+                }
+                if (_prefetch_cancel == cancel) {
+                    _prefetch_cancel.reset();
+                }
+                emit on_PrefetchFinished(count);
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void StyleSheetManager::watch(Item* item, StyleSheetBase* source)
+{
+    if (source == nullptr) {
+        return;
+    }
+    if (!item->sources.contains(source)) {
+        item->sources.append(source);
+        auto& dependents = _source_index[source];
+        if (dependents.source.isNull()) {
+            dependents.source = StyleSheetBase::adopt(source);
+        }
+        dependents.widgets.insert(item->widget);
+    }
+    // 内置样式与自定义样式没有外部文件，不必生成路径
+    if (!source->isExternal()) {
+        return;
+    }
+    for (auto theme : {Theme::LIGHT, Theme::DARK}) {
+        // 资源文件不会变化
+        auto path = source->stylePath(theme);
+        if (path.isEmpty() || path.startsWith(':') ||
+            item->paths.contains(path)) {
+            continue;
+        }
+        item->paths.append(path);
+        auto& widgets = _path_index[path];
+        if (widgets.isEmpty() && _watcher != nullptr) {
+            _watcher->addPath(path);
+        }
+        widgets.insert(item->widget);
+    }
+}
+
+void StyleSheetManager::unwatch(Item* item)
+{
+    for (auto source : std::as_const(item->sources)) {
+        auto it = _source_index.find(source);
+        if (it == _source_index.end()) {
+            continue;
+        }
+        it->widgets.remove(item->widget);
+        if (it->widgets.isEmpty()) {
+            // 可能是最后一个引用，移除共享后再释放
+            const auto held = std::move(it->source);
+            _source_index.erase(it);
+            this->unshare(held.get());
+        }
+    }
+    item->sources.clear();
+    for (const auto& path : item->paths) {
+        auto it = _path_index.find(path);
+        if (it == _path_index.end()) {
+            continue;
+        }
+        it->remove(item->widget);
+        if (it->isEmpty()) {
+            _path_index.erase(it);
+            if (_watcher != nullptr) {
+                _watcher->removePath(path);
+            }
+        }
+    }
+    item->paths.clear();
+}
+
+QList<QWidget*> StyleSheetManager::dependents(StyleSheetBase* source) const
+{
+    auto it = _source_index.constFind(source);
+    if (it == _source_index.constEnd()) {
+        return {};
+    }
+    return it->widgets.values();
+}
+
+void StyleSheetManager::invalidate(StyleSheetBase* source)
+{
+    auto it = _source_index.constFind(source);
+    if (it == _source_index.constEnd()) {
+        return;
+    }
+    // 共享的样式同时存在于应用程序样式中
+    if (_app_mode && !source->styleKey().isEmpty()) {
+        _app_sources.remove(source->styleKey());
+        this->share(source);
+        this->applyApplicationStyleSheet(Config::instance()->getTheme());
+    }
+    // 应用时注册表可能变化，使用副本
+    const auto widgets = it->widgets;
+    this->reapply(widgets);
+}
+
+QList<QWidget*> StyleSheetManager::dependents(const QString& path) const
+{
+    auto it = _path_index.constFind(path);
+    if (it == _path_index.constEnd()) {
+        return {};
+    }
+    return it->values();
+}
+
+void StyleSheetManager::setWatchEnabled(bool enable)
+{
+    if (enable == (_watcher != nullptr)) {
+        return;
+    }
+    if (!enable) {
+        _watch_timer.stop();
+        _changed_paths.clear();
+        delete _watcher;
+        _watcher = nullptr;
+        return;
+    }
+    _watcher = new QFileSystemWatcher(this);
+    connect(_watcher, &QFileSystemWatcher::fileChanged, this,
+            &StyleSheetManager::fileChanged);
+    if (!_path_index.isEmpty()) {
+        _watcher->addPaths(_path_index.keys());
+    }
+}
+
+void StyleSheetManager::fileChanged(const QString& path)
+{
+    _changed_paths.insert(path);
+    _watch_timer.start();
+}
+
+void StyleSheetManager::reloadFiles()
+{
+    if (_watcher == nullptr) {
+        return;
+    }
+    QSet<QWidget*> widgets;
+    for (const auto& path : std::as_const(_changed_paths)) {
+        auto it = _path_index.constFind(path);
+        if (it == _path_index.constEnd()) {
+            continue;
+        }
+        // 编辑器以替换方式保存时文件会从监视列表中移除
+        if (!_watcher->files().contains(path) && QFileInfo::exists(path)) {
+            _watcher->addPath(path);
+        }
+        // 只使依赖该文件的组件的组合样式失效(reapply)，其他组件的
+        // 组合结果与预取结果保持有效
+        StyleSheetCache::instance()->invalidate(path);
+        widgets.unite(it.value());
+        _app_dirty = true;
+    }
+    _changed_paths.clear();
+    if (widgets.isEmpty()) {
+        return;
+    }
+    if (_app_mode) {
+        this->applyApplicationStyleSheet(Config::instance()->getTheme());
+    }
+    this->reapply(widgets);
+}
+
+void StyleSheetManager::reapply(const QSet<QWidget*>& widgets)
+{
+    const auto theme = Config::instance()->getTheme();
+    for (auto widget : widgets) {
+        // 应用过程中其他组件可能已被注销
+        const auto it = _index.constFind(widget);
+        if (it == _index.constEnd()) {
+            continue;
+        }
+        auto& item = _items[_slots[it.value()].index];
+        if (!item.source.isNull()) {
+            item.source->invalidate();
+        }
+        if (!widget->isVisible()) {
+            this->setLazy(it.value(), true);
+            continue;
+        }
+        try {
+            this->apply(widget, theme);
+        } catch (...) {
+            this->deReg(widget);
+        }
+    }
+    this->schedulePrefetch();
+}
+
+void StyleSheetManager::setApplicationMode(bool enable)
+{
+    if (_app_mode == enable) {
+        return;
+    }
+    _app_mode = enable;
+    if (enable) {
+        QList<StyleSheetBase*> sources;
+        for (const auto& it : _items) {
+            if (!it.source.isNull()) {
+                it.source->sharedSources(sources);
+            }
+        }
+        for (auto it : sources) {
+            this->share(it);
+        }
+        _app_dirty = true;
+    } else if (_app_hash != 0) {
+        qApp->setStyleSheet("");
+        _app_hash = 0;
+    }
+    // 组件样式内容发生变化，全部重新应用
+    for (auto& it : _items) {
+        it.hash = 0;
+    }
+    this->update();
+}
+
+void StyleSheetManager::share(StyleSheetBase* source)
+{
+    if (!_app_mode || source == nullptr) {
+        return;
+    }
+    auto key = source->styleKey();
+    if (key.isEmpty() || _app_sources.contains(key)) {
+        return;
+    }
+    // 样式已由组合样式持有，这里只增加引用
+    _app_sources.insert(key, StyleSheetBase::adopt(source));
+    _app_dirty = true;
+}
+
+void StyleSheetManager::unshare(StyleSheetBase* source)
+{
+    const auto key = source->styleKey();
+    auto it = _app_sources.find(key);
+    if (key.isEmpty() || it == _app_sources.end() || it->get() != source) {
+        return;
+    }
+    _app_sources.erase(it);
+    // 其他同名样式仍在使用时改为共享它
+    for (auto other = _source_index.cbegin(); other != _source_index.cend();
+         ++other) {
+        if (other.key()->styleKey() == key) {
+            this->share(other.key());
+            break;
+        }
+    }
+    _app_dirty = true;
+    // 注销可能发生在组件析构过程中，稍后再更新应用程序样式
+    QMetaObject::invokeMethod(
+        this,
+        [this]() {
+            if (_app_mode && _app_dirty) {
+                this->applyApplicationStyleSheet(
+                    Config::instance()->getTheme());
+            }
+        },
+        Qt::QueuedConnection);
+}
+
+void StyleSheetManager::applyApplicationStyleSheet(Theme theme)
+{
+    _app_dirty = false;
+    QString qss;
+    for (const auto& it : _app_sources) {
+        if (_strategy == ThemeStrategy::PropertySelector) {
+            for (auto t : {Theme::LIGHT, Theme::DARK}) {
+                qss.append(ScopeThemeStyleSheet(it->themeContent(t), t));
+            }
+        } else {
+            qss.append(it->themeContent(theme));
+            qss.append('\n');
+        }
+    }
+    auto hash = getStyleSheetHash(qss);
+    if (hash == _app_hash) {
+        ++_skipped;
+        return;
+    }
+    _app_hash = hash;
+    QLW_STATS_SCOPE(Stats.set_style_sheet);
+    qApp->setStyleSheet(qss);
+    ++_applied;
+}
+
+bool StyleSheetManager::eventFilter(QObject* watched, QEvent* event)
+{
+    switch (event->type()) {
+    case QEvent::DynamicPropertyChange:
+        if (watched->isWidgetType()) {
+            auto e = static_cast<QDynamicPropertyChangeEvent*>(event);
+            this->customStyleSheetChanged(static_cast<QWidget*>(watched),
+                                          e->propertyName());
+        }
+        break;
+    case QEvent::Paint:
+        this->lazyApply(static_cast<QWidget*>(watched));
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void StyleSheetManager::customStyleSheetChanged(QWidget* widget,
+                                                const QByteArray& name)
+{
+    if (name != CustomStyleSheet::LIGHT_QSS_KEY &&
+        name != CustomStyleSheet::DARK_QSS_KEY) {
+        return;
+    }
+    // 组合中已有读取属性的 CustomStyleSheet，只需重新组合
+    const auto it = _index.constFind(widget);
+    if (it == _index.constEnd()) {
+        return;
+    }
+    auto& item = _items[_slots[it.value()].index];
+    if (item.source.isNull()) {
+        // 仅使用主题后端的组件
+        item.source.reset(
+            new StyleSheetCompose({new CustomStyleSheet(widget)}));
+    }
+    item.source->invalidate();
+    // 亮色与暗色样式通常连续设置，各触发一次事件，
+    // 标记后等待绘制时只应用一次
+    this->setLazy(it.value(), true);
+    widget->update();
+}
+
+void StyleSheetManager::lazyApply(QWidget* widget)
+{
+    if (_lazy_count == 0) {
+        return;
+    }
+    const auto it = _index.constFind(widget);
+    if (it == _index.constEnd() || !_lazy.testBit(it.value())) {
+        return;
+    }
+    QLW_TRACE_SCOPE("StyleSheetManager::lazyApply", widget);
+    this->apply(widget, Config::instance()->getTheme());
+}
 
 /*------------------- StyleSheetBase -------------------*/
 
@@ -74,11 +891,120 @@ QString StyleSheetBase::styleContent(Theme theme)
     return getStyleSheetFromFile(this->stylePath(theme));
 }
 
+QString StyleSheetBase::themeContent(Theme theme)
+{
+    auto qss = this->styleContent(theme);
+    if (_templates == nullptr) {
+        _templates = std::make_unique<std::array<Template, ThemeCount>>();
+    }
+    auto& it = (*_templates)[theme];
+    // 内容通常共享同一份数据，先比较指针
+    const auto same = (qss.constData() == it.source.constData() &&
+                       qss.size() == it.source.size()) ||
+                      qss == it.source;
+    if (!same) {
+        it.source = qss;
+        it.tmpl = StyleTemplate(qss);
+        it.token_generation = 0;
+    }
+    if (!it.tmpl.hasTokens()) {
+        return qss;
+    }
+    const auto generation = ThemeTokens::instance()->generation();
+    if (it.token_generation != generation) {
+        it.content = it.tmpl.render(theme);
+        it.token_generation = generation;
+    }
+    return it.content;
+}
+
 void StyleSheetBase::apply(QWidget* widget, Theme theme)
 {
     setThemeStyleSheet(widget, this, theme);
 }
 
+QSharedPointer<StyleSheetBase> StyleSheetBase::adopt(StyleSheetBase* source)
+{
+    auto shared = source->sharedFromThis();
+    if (shared.isNull()) {
+        shared.reset(source);
+    }
+    return shared;
+}
+
+/*------------------- StyleSheetCache -------------------*/
+
+StyleSheetCache* StyleSheetCache::Self = nullptr;
+
+StyleSheetCache* StyleSheetCache::instance()
+{
+    if (StyleSheetCache::Self == nullptr) {
+        static QMutex mutex;
+        QMutexLocker locker{&mutex};
+
+        if (StyleSheetCache::Self == nullptr) {
+            StyleSheetCache::Self = new StyleSheetCache();
+        }
+    }
+    return StyleSheetCache::Self;
+}
+
+QString StyleSheetCache::content(const QString& path, Theme theme)
+{
+    if (path.isEmpty()) {
+        return "";
+    }
+    QMutexLocker locker{&_mutex};
+    // 变量变化后重新生成，模板无需重新编译
+    const auto token_generation = ThemeTokens::instance()->generation();
+    if (_token_generation != token_generation) {
+        _token_generation = token_generation;
+        for (auto& slot : _slots) {
+            slot.clear();
+        }
+        _generation.fetchAndAddRelease(1);
+    }
+
+    auto& slot = _slots[theme];
+    auto it = slot.constFind(path);
+    if (it != slot.constEnd()) {
+        return it.value();
+    }
+    auto tmpl = _templates.constFind(path);
+    if (tmpl == _templates.constEnd()) {
+        tmpl = _templates.insert(path, StyleTemplate(getStyleSheetFromFile(path)));
+    }
+    auto content = tmpl.value().render(theme);
+    slot.insert(path, content);
+    return content;
+}
+
+void StyleSheetCache::invalidate(const QString& path)
+{
+    QMutexLocker locker{&_mutex};
+    _templates.remove(path);
+    for (auto& slot : _slots) {
+        slot.remove(path);
+    }
+}
+
+void StyleSheetCache::invalidate(Theme theme)
+{
+    QMutexLocker locker{&_mutex};
+    _slots[theme].clear();
+    _generation.fetchAndAddRelease(1);
+}
+
+void StyleSheetCache::clear()
+{
+    QMutexLocker locker{&_mutex};
+    _templates.clear();
+    for (auto& slot : _slots) {
+        slot.clear();
+    }
+    _generation.fetchAndAddRelease(1);
+}
+
 /*------------------- Other StyleSheet -------------------*/
 
 const char* CustomStyleSheet::LIGHT_QSS_KEY = "light_custom_qss";
@@ -86,7 +1012,6 @@ const char* CustomStyleSheet::DARK_QSS_KEY = "dark_custom_qss";
 
 QString CustomStyleSheet::styleContent(Theme theme)
 {
-    theme = Config::instance()->getTheme();
     if (theme == Theme::LIGHT) {
         return lightStyleSheet();
     }
@@ -95,83 +1020,290 @@ QString CustomStyleSheet::styleContent(Theme theme)
 
 StyleSheetCompose::StyleSheetCompose(
     std::initializer_list<StyleSheetBase*> list)
-    : _list(list)
 {
-}
-StyleSheetCompose::~StyleSheetCompose()
-{
-    for (auto it : _list) {
+    _list.reserve(qsizetype(list.size()));
+    for (auto it : list) {
         if (it != nullptr) {
-            delete it;
+            _list.append(StyleSheetBase::adopt(it));
         }
     }
 }
 QString StyleSheetCompose::styleContent(Theme theme)
+{
+    QLW_TRACE_SCOPE("StyleSheetCompose::styleContent");
+    return this->compose(_composed[theme], theme, false).content;
+}
+QString StyleSheetCompose::localContent(Theme theme)
+{
+    return this->compose(_local[theme], theme, true).content;
+}
+quint64 StyleSheetCompose::contentHash(Theme theme, bool local)
+{
+    return this->compose(local ? _local[theme] : _composed[theme], theme, local)
+        .hash;
+}
+quint64 StyleSheetCompose::scopedHash(bool local)
+{
+    return this->scoped(local).hash;
+}
+void StyleSheetCompose::sharedSources(QList<StyleSheetBase*>& list) const
+{
+    for (const auto& it : _list) {
+        if (!it->styleKey().isEmpty()) {
+            list.append(it.get());
+        }
+    }
+}
+QString StyleSheetCompose::scopedContent(bool local)
+{
+    return this->scoped(local).content;
+}
+const StyleSheetCompose::Composed& StyleSheetCompose::scoped(bool local)
+{
+    auto& composed = _scoped[local ? 1 : 0];
+    if (this->isValid(composed)) {
+        return composed;
+    }
+    auto content = ScopeThemeStyleSheet(
+        compose(local ? _local[Theme::LIGHT] : _composed[Theme::LIGHT],
+                Theme::LIGHT, local)
+            .content,
+        Theme::LIGHT);
+    content.append(ScopeThemeStyleSheet(
+        compose(local ? _local[Theme::DARK] : _composed[Theme::DARK],
+                Theme::DARK, local)
+            .content,
+        Theme::DARK));
+    this->stamp(composed, content);
+    return composed;
+}
+bool StyleSheetCompose::isValid(const Composed& composed) const
+{
+    return composed.generation == _generation &&
+           composed.cache_generation ==
+               StyleSheetCache::instance()->generation() &&
+           composed.token_generation == ThemeTokens::instance()->generation();
+}
+void StyleSheetCompose::stamp(Composed& composed, const QString& content) const
+{
+    composed.generation = _generation;
+    composed.cache_generation = StyleSheetCache::instance()->generation();
+    composed.token_generation = ThemeTokens::instance()->generation();
+    composed.hash = getStyleSheetHash(content);
+    composed.content = content;
+}
+const StyleSheetCompose::Composed&
+StyleSheetCompose::compose(Composed& composed, Theme theme, bool local)
+{
+    if (this->isValid(composed)) {
+        return composed;
+    }
+
+    QLW_STATS(StyleSheetStats::Timer compose_timer{Stats.compose});
+    QString content;
+    for (const auto& it : _list) {
+        if (local && !it->styleKey().isEmpty()) {
+            continue;
+        }
+        QString qss;
+        {
+            QLW_STATS(StyleSheetStats::Timer read_timer{Stats.read,
+                                                        &compose_timer});
+            qss = it->themeContent(theme);
+        }
+        content.append(qss);
+        content.append('\n');
+    }
+    this->stamp(composed, content);
+    return composed;
+}
+void StyleSheetCompose::release(Theme theme)
+{
+    _composed[theme] = Composed();
+    _local[theme] = Composed();
+}
+
+qsizetype StyleSheetCompose::composedBytes(Theme theme, bool local) const
+{
+    const auto& composed = local ? _local[theme] : _composed[theme];
+    return this->isValid(composed)
+               ? composed.content.size() * qsizetype(sizeof(QChar))
+               : 0;
+}
+
+qsizetype StyleSheetCompose::composedBytes() const
+{
+    qsizetype size = 0;
+    auto add = [this, &size](const Composed& composed) {
+        if (this->isValid(composed)) {
+            size += composed.content.size() * qsizetype(sizeof(QChar));
+        }
+    };
+    std::for_each(_composed.begin(), _composed.end(), add);
+    std::for_each(_local.begin(), _local.end(), add);
+    std::for_each(_scoped.begin(), _scoped.end(), add);
+    return size;
+}
+bool StyleSheetCompose::isComposed(Theme theme, bool local) const
+{
+    return this->isValid(local ? _local[theme] : _composed[theme]);
+}
+StyleSheetCompose::Snapshot StyleSheetCompose::snapshot(Theme theme,
+                                                        bool local)
+{
+    Snapshot snapshot;
+    snapshot.theme = theme;
+    snapshot.local = local;
+    snapshot.generation = _generation;
+    snapshot.cache_generation = StyleSheetCache::instance()->generation();
+    snapshot.token_generation = ThemeTokens::instance()->generation();
+    snapshot.parts.reserve(_list.size());
+    for (const auto& it : _list) {
+        if (local && !it->styleKey().isEmpty()) {
+            continue;
+        }
+        // 快照持有引用，组合中的样式在预取期间被移除时不会释放
+        if (it->isThreadSafe()) {
+            snapshot.parts.append({it, QString()});
+        } else {
+            snapshot.parts.append({nullptr, it->themeContent(theme)});
+        }
+    }
+    return snapshot;
+}
+QString StyleSheetCompose::render(const Snapshot& snapshot)
 {
     QString content;
-    for (auto it : _list) {
-        content.append(it->styleContent(theme));
+    for (const auto& [source, text] : snapshot.parts) {
+        content.append(!source.isNull() ? source->themeContent(snapshot.theme)
+                                        : text);
         content.append('\n');
     }
     return content;
 }
+bool StyleSheetCompose::prime(const Snapshot& snapshot, const QString& content,
+                              quint64 hash)
+{
+    if (snapshot.generation != _generation ||
+        snapshot.cache_generation !=
+            StyleSheetCache::instance()->generation() ||
+        snapshot.token_generation != ThemeTokens::instance()->generation()) {
+        return false;
+    }
+    auto& composed =
+        snapshot.local ? _local[snapshot.theme] : _composed[snapshot.theme];
+    composed.generation = snapshot.generation;
+    composed.cache_generation = snapshot.cache_generation;
+    composed.token_generation = snapshot.token_generation;
+    composed.hash = hash;
+    composed.content = content;
+    return true;
+}
 void StyleSheetCompose::add(StyleSheetBase* source)
 {
-    if (source == this || _list.contains(source)) {
+    if (source == nullptr || source == this) {
         return;
     }
-    _list.push_back(source);
+    for (const auto& it : std::as_const(_list)) {
+        if (it.get() == source) {
+            return;
+        }
+    }
+    _list.push_back(StyleSheetBase::adopt(source));
+    invalidate();
 }
 void StyleSheetCompose::remove(StyleSheetBase* source)
 {
-    _list.removeIf([source](StyleSheetBase* s) { return source == s; });
+    if (_list.removeIf([source](const QSharedPointer<StyleSheetBase>& s) {
+            return s.get() == source;
+        }) > 0) {
+        invalidate();
+    }
 }
 
-/*------------------- StyleSheetWatcher -------------------*/
-
-const char* LineStyleSheetWatcher::LINE_PROPERTY_KEY = "line-property-key";
+/*------------------- Global -------------------*/
 
-bool CustomStyleSheetWatcher::eventFilter(QObject* watched, QEvent* event)
+// 应用主题颜色
+QString ApplyThemeColor(const QString& qss, Theme theme)
 {
-    if (event->type() == QEvent::DynamicPropertyChange &&
-        watched->isWidgetType()) {
+    if (!qss.contains('@')) {
+        return qss;
+    }
+    return StyleTemplate(qss).render(theme);
+}
 
-        auto e = dynamic_cast<QDynamicPropertyChangeEvent*>(event);
-        auto widget = qobject_cast<QWidget*>(watched);
-        QString name{e->propertyName()};
+// 为样式中的每个选择器加上主题属性限定
+QString ScopeThemeStyleSheet(const QString& qss, Theme theme)
+{
+    // 属性设置在组件自身，选择器需要同时匹配其祖先与自身:
+    // "A B" -> "*[qlwTheme="dark"] A B, A[qlwTheme="dark"] B"
+    const QString attr = QString("[") +
+                         StyleSheetManager::THEME_PROPERTY_KEY + "=\"" +
+                         (theme == Theme::DARK ? "dark" : "light") + "\"]";
+    const QString any = "*" + attr + " ";
 
-        if (name == CustomStyleSheet::LIGHT_QSS_KEY ||
-            name == CustomStyleSheet::DARK_QSS_KEY) {
-            addThemeStyleSheet(widget, new CustomStyleSheet(widget));
+    // 去除注释
+    QString source;
+    source.reserve(qss.size());
+    qsizetype pos = 0;
+    while (pos < qss.size()) {
+        auto start = qss.indexOf("/*", pos);
+        if (start < 0) {
+            source.append(QStringView(qss).mid(pos));
+            break;
         }
+        source.append(QStringView(qss).mid(pos, start - pos));
+        auto end = qss.indexOf("*/", start + 2);
+        pos = end < 0 ? qss.size() : end + 2;
     }
-    return QObject::eventFilter(watched, event);
-}
 
-bool LineStyleSheetWatcher::eventFilter(QObject* watched, QEvent* event)
-{
-    if (watched->isWidgetType() &&
-        !watched->property(LINE_PROPERTY_KEY).isNull() &&
-        event->type() == QEvent::Paint) {
+    QString content;
+    content.reserve(source.size() * 2);
+    pos = 0;
+    while (pos < source.size()) {
+        auto open = source.indexOf('{', pos);
+        if (open < 0) {
+            break;
+        }
+        auto close = source.indexOf('}', open);
+        if (close < 0) {
+            close = source.size() - 1;
+        }
 
-        auto widget = qobject_cast<QWidget*>(watched);
-        watched->setProperty(LINE_PROPERTY_KEY, false);
+        bool first = true;
+        const auto selectors = QStringView(source).mid(pos, open - pos);
+        for (auto selector : selectors.split(',')) {
+            selector = selector.trimmed();
+            if (selector.isEmpty()) {
+                continue;
+            }
+            if (!first) {
+                content.append(',');
+            }
+            first = false;
+            content.append(any);
+            content.append(selector);
+            content.append(',');
 
-        auto& items = StyleSheetManager::instance()->items();
-        auto it = items.find(widget);
-        if (it != items.end()) {
-            widget->setStyleSheet(getThemeStyleSheet(
-                (*it).source.get(), Config::instance()->getTheme()));
+            // 属性插入到第一个选择器的伪状态之前
+            qsizetype end = 0;
+            while (end < selector.size() && !selector[end].isSpace() &&
+                   selector[end] != '>') {
+                ++end;
+            }
+            auto colon = selector.left(end).indexOf(':');
+            auto at = colon < 0 ? end : colon;
+            content.append(selector.left(at));
+            content.append(attr);
+            content.append(selector.mid(at));
         }
+        content.append(QStringView(source).mid(open, close - open + 1));
+        content.append('\n');
+        pos = close + 1;
     }
-    return QObject::eventFilter(watched, event);
+    return content;
 }
 
-/*------------------- Global -------------------*/
-
-// 应用主题颜色
-QString ApplyThemeColor(const QString& qss) { return qss; }
-
 // 从文件获取样式内容
 QString getStyleSheetFromFile(const QString& path)
 {
@@ -184,26 +1316,52 @@ QString getStyleSheetFromFile(const QString& path)
     return content;
 }
 
+// 计算样式内容的 64 位哈希
+quint64 getStyleSheetHash(const QString& qss)
+{
+    quint64 hash = qHash(qss);
+    if constexpr (sizeof(size_t) < sizeof(quint64)) {
+        hash = (hash << 32) | qHash(qss, 0x9e3779b9U);
+    }
+    return hash;
+}
+
 // 从 StyleSheet 获取主题样式
 QString getThemeStyleSheet(StyleSheetBase* source, Theme theme)
 {
-    return ApplyThemeColor(source->styleContent(theme));
+    return source->themeContent(theme);
 }
 QString getThemeStyleSheet(const QString& path, Theme theme)
 {
-    QScopedPointer<FileStyleSheet> source(new FileStyleSheet(path));
-    return ApplyThemeColor(source->styleContent(theme));
+    return StyleSheetCache::instance()->content(path, theme);
 }
 
 // 为组件设置主题样式
 void setThemeStyleSheet(QWidget* widget, StyleSheetBase* source, Theme theme,
                         bool reg)
 {
+    QLW_TRACE_SCOPE("setThemeStyleSheet", widget);
     if (reg) {
-        StyleSheetManager::instance()->reg(source, widget);
+        auto manager = StyleSheetManager::instance();
+        manager->reg(source, widget);
+        manager->apply(widget, theme);
+        return;
     }
     widget->setStyleSheet(getThemeStyleSheet(source, theme));
 }
+// 为组件设置主题后端
+void setThemeBackend(QWidget* widget,
+                     const QSharedPointer<ThemeBackend>& backend, Theme theme,
+                     bool reg)
+{
+    if (reg) {
+        auto manager = StyleSheetManager::instance();
+        manager->reg(backend, widget);
+        manager->apply(widget, theme);
+        return;
+    }
+    backend->applyTheme(widget, theme);
+}
 // 设置自定义样式
 void setCustomStyleSheet(QWidget* widget, const QString& light_qss,
                          const QString& dark_qss)
@@ -215,14 +1373,14 @@ void setCustomStyleSheet(QWidget* widget, const QString& light_qss,
 void addThemeStyleSheet(QWidget* widget, StyleSheetBase* source, Theme theme,
                         bool reg)
 {
-    QString qss;
     if (reg) {
-        StyleSheetManager::instance()->reg(source, widget, false);
-        qss = getThemeStyleSheet(source, theme);
-    } else {
-        qss = widget->styleSheet() + '\n' + getThemeStyleSheet(source, theme);
+        auto manager = StyleSheetManager::instance();
+        manager->reg(source, widget, false);
+        manager->apply(widget, theme);
+        return;
     }
 
+    auto qss = widget->styleSheet() + '\n' + getThemeStyleSheet(source, theme);
     if (qss != widget->styleSheet()) {
         widget->setStyleSheet(qss);
     }
@@ -230,15 +1388,14 @@ void addThemeStyleSheet(QWidget* widget, StyleSheetBase* source, Theme theme,
 void addThemeStyleSheet(QWidget* widget, const QString& path, Theme theme,
                         bool reg)
 {
-    QString qss;
     if (reg) {
-        StyleSheetManager::instance()->reg(new FileStyleSheet(path), widget,
-                                           false);
-        qss = getThemeStyleSheet(path, theme);
-    } else {
-        qss = widget->styleSheet() + '\n' + getThemeStyleSheet(path, theme);
+        auto manager = StyleSheetManager::instance();
+        manager->reg(new FileStyleSheet(path), widget, false);
+        manager->apply(widget, theme);
+        return;
     }
 
+    auto qss = widget->styleSheet() + '\n' + getThemeStyleSheet(path, theme);
     if (qss != widget->styleSheet()) {
         widget->setStyleSheet(qss);
     }
@@ -247,28 +1404,8 @@ void addThemeStyleSheet(QWidget* widget, const QString& path, Theme theme,
 // 更新样式
 void updateStyleSheet(bool lazy)
 {
-    QList<QWidget*> removes;
-    const auto& items = StyleSheetManager::instance()->items();
-    for (auto& it : items.toStdMap()) {
-        auto widget = it.first;
-        auto source = it.second.source.get();
-
-        try {
-            if (!lazy && !widget->visibleRegion().isNull()) {
-                widget->setStyleSheet(
-                    getThemeStyleSheet(source, Config::instance()->getTheme()));
-            } else {
-                widget->setProperty(LineStyleSheetWatcher::LINE_PROPERTY_KEY,
-                                    true);
-            }
-        } catch (...) {
-            removes.append(widget);
-        }
-    }
-    auto manager = StyleSheetManager::instance();
-    for (auto it : removes) {
-        manager->deReg(it);
-    }
+    QLW_TRACE_SCOPE("updateStyleSheet");
+    StyleSheetManager::instance()->update(lazy);
 }
 
 // 设置主题
@@ -5,117 +5,545 @@
 
 #pragma once
 
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QBitArray>
+#include <QElapsedTimer>
+#include <QEnableSharedFromThis>
 #include <QEvent>
+#include <QFileSystemWatcher>
+#include <QMutex>
 #include <QObject>
+#include <QSet>
+#include <QTimer>
 #include <QVariant>
 #include <QWidget>
+#include <array>
+#include <bit>
 #include <format>
+#include <memory>
+#include <string_view>
 
 #include "3rdparty/magic_enum/magic_enum.hpp"
 #include "config.h"
+#include "theme_backend.h"
+#include "theme_token.h"
+
+#if defined(QLW_EMBEDDED_QSS)
+#include "qlw_qss_table.h"
+#endif
 
 namespace QLW
 {
 
 class StyleSheetBase;
-class CustomStyleSheetWatcher;
-class LineStyleSheetWatcher;
+class StyleSheetCompose;
+
+// 统计信息的收集代码，未定义 QLW_ENABLE_STATS 时不参与编译
+#if defined(QLW_ENABLE_STATS)
+#define QLW_STATS(...) __VA_ARGS__
+#else
+#define QLW_STATS(...)
+#endif
+#define QLW_STATS_SCOPE(histogram)                                             \
+    QLW_STATS(StyleSheetStats::Timer qlw_stats_timer_{histogram})
+
+// 样式统计
+struct StyleSheetStats
+{
+    // 按 log2(纳秒) 分桶的耗时直方图，第 i 个桶为 [2^(i-1), 2^i)
+    struct Histogram
+    {
+        std::array<quint64, 40> buckets{};
+        quint64 count{0};
+        quint64 total{0};
+
+        void add(qint64 nsecs)
+        {
+            const auto ns = quint64(qMax<qint64>(nsecs, 0));
+            const auto index =
+                qMin<qsizetype>(std::bit_width(ns), buckets.size() - 1);
+            ++buckets[index];
+            ++count;
+            total += ns;
+        }
+        // 平均耗时(纳秒)
+        [[nodiscard]] double mean() const
+        {
+            return count == 0 ? 0.0 : double(total) / double(count);
+        }
+    };
+    // 作用域计时，parent 不为空时本段耗时从 parent 中扣除，
+    // 嵌套的阶段各自只记录自身的耗时
+    class Timer
+    {
+    public:
+        explicit Timer(Histogram& histogram, Timer* parent = nullptr)
+            : _histogram(histogram)
+            , _parent(parent)
+        {
+            _timer.start();
+        }
+        ~Timer()
+        {
+            const auto nsecs = _timer.nsecsElapsed();
+            _histogram.add(nsecs - _excluded);
+            if (_parent != nullptr) {
+                _parent->_excluded += nsecs;
+            }
+        }
+
+    private:
+        Histogram& _histogram;
+        Timer* _parent{nullptr};
+        QElapsedTimer _timer;
+        qint64 _excluded{0};
+    };
+
+    // 已注册组件数
+    qsizetype registered{0};
+    // 所有组件已组合样式的字节数
+    qsizetype composed_bytes{0};
+    // 重新应用、跳过、延迟到绘制时的次数
+    quint64 applied{0};
+    quint64 skipped{0};
+    quint64 deferred{0};
+    // 各阶段耗时，互不重叠:
+    // read 读取子样式(文件缓存、变量替换)，compose 组合，不含 read，
+    // set_style_sheet 调用 setStyleSheet，包含 Qt 随之进行的 polish，
+    // polish 只在属性选择策略下样式未变化、只切换 qlwTheme 属性时记录
+    Histogram read;
+    Histogram compose;
+    Histogram set_style_sheet;
+    Histogram polish;
+};
+
+// 主题切换策略
+enum class ThemeStrategy
+{
+    // 切换时重新生成并设置样式内容
+    StyleSheet,
+    // 样式同时包含所有主题，切换时只修改 qlwTheme 属性并重新 polish
+    PropertySelector,
+};
 
 // 样式管理
 class StyleSheetManager : public QObject
 {
     Q_OBJECT;
 
+signals:
+    // 分片更新进度
+    void on_UpdateProgress(int done, int total);
+    // 样式更新完成
+    void on_UpdateFinished();
+    // 另一个主题的样式预取完成，count 为本次预取的组件数
+    void on_PrefetchFinished(int count);
+    // 每次更新完成后发送，仅在定义 QLW_ENABLE_STATS 时发送
+    void on_StatsUpdated(const QLW::StyleSheetStats& stats);
+
 public:
+    // 注册项句柄，组件注销后失效
+    struct Handle
+    {
+        quint32 slot{~0U};
+        quint32 generation{0};
+    };
+
     class Item
     {
     public:
         Item() = default;
-        explicit Item(StyleSheetBase* s, CustomStyleSheetWatcher* c_watcher,
-                      LineStyleSheetWatcher* l_watcher)
-            : source(s)
-            , custom_watcher(c_watcher)
-            , line_watcher(l_watcher)
+        explicit Item(QWidget* w, StyleSheetCompose* s)
+            : widget(w)
+            , source(s)
         {
         }
         ~Item() = default;
 
     public:
-        QSharedPointer<StyleSheetBase> source;
-        QSharedPointer<CustomStyleSheetWatcher> custom_watcher;
-        QSharedPointer<LineStyleSheetWatcher> line_watcher;
+        QWidget* widget{nullptr};
+        // 样式表，仅使用主题后端时为空
+        QSharedPointer<StyleSheetCompose> source;
+        // 主题后端，可与样式表同时使用
+        QSharedPointer<ThemeBackend> backend;
+        // 最近一次应用后端的主题，-1 表示未应用
+        int backend_theme{-1};
+        // 最近一次应用的样式哈希
+        quint64 hash{0};
+        // 最近一次选择的主题(属性选择策略)，-1 表示未选择
+        int theme{-1};
+        // 注册时传入的样式
+        QList<StyleSheetBase*> sources;
+        // 依赖的外部样式文件
+        QStringList paths;
     };
 
+public:
+    static const char* THEME_PROPERTY_KEY;
+
 public:
     ~StyleSheetManager() = default;
     static StyleSheetManager* instance();
     void reg(StyleSheetBase* source, QWidget* widget, bool reset = true);
+    void reg(const QSharedPointer<ThemeBackend>& backend, QWidget* widget);
     void deReg(QWidget* widget);
-    auto& items();
+    // 已注册项，连续存储，顺序不固定
+    [[nodiscard]] const QList<Item>& items() const { return _items; }
+    [[nodiscard]] qsizetype count() const { return _items.size(); }
+    // 获取组件的注册句柄，未注册时返回无效句柄
+    [[nodiscard]] Handle handle(QWidget* widget) const;
+    // 获取注册项，句柄失效或未注册时返回 nullptr
+    [[nodiscard]] Item* item(Handle handle);
+    [[nodiscard]] Item* item(QWidget* widget);
+    // 为已注册组件应用主题样式，样式未变化时跳过 setStyleSheet
+    bool apply(QWidget* widget, Theme theme);
+    // 样式内容已变化，只重新应用使用该样式的组件
+    void invalidate(StyleSheetBase* source);
+    // 使用指定样式的组件
+    [[nodiscard]] QList<QWidget*> dependents(StyleSheetBase* source) const;
+    // 实际调用 setStyleSheet 的次数
+    [[nodiscard]] quint64 appliedCount() const { return _applied; }
+    // 因样式未变化而跳过的次数
+    [[nodiscard]] quint64 skippedCount() const { return _skipped; }
+    // 延迟到绘制时更新的次数
+    [[nodiscard]] quint64 deferredCount() const { return _deferred; }
+    // 统计快照，未定义 QLW_ENABLE_STATS 时耗时直方图为空
+    [[nodiscard]] StyleSheetStats stats() const;
+    void resetStats();
+
+    // 更新所有已注册组件的样式
+    void update(bool lazy = false);
+    // 每次事件循环的更新预算(毫秒)，不大于 0 时同步更新
+    void setUpdateBudget(int msec) { _budget = msec; }
+    [[nodiscard]] int updateBudget() const { return _budget; }
+    // 是否有未完成的分片更新
+    [[nodiscard]] bool isUpdating() const { return !_pending.isEmpty(); }
+
+    // 应用程序样式模式: 选择器已限定到组件类的内置样式(LineStyleSheet)
+    // 合并为一份 qApp 样式，组件只设置各自的其他样式，
+    // FileStyleSheet 等样式的选择器作用范围未知，仍由组件各自设置
+    void setApplicationMode(bool enable);
+    [[nodiscard]] bool isApplicationMode() const { return _app_mode; }
+
+    // 主题切换策略
+    void setStrategy(ThemeStrategy strategy);
+    [[nodiscard]] ThemeStrategy strategy() const { return _strategy; }
+
+    // 事件循环空闲时在工作线程中预先组合另一个主题的样式，
+    // 切换时只需 setStyleSheet，默认关闭
+    void setPrefetchEnabled(bool enable);
+    [[nodiscard]] bool isPrefetchEnabled() const { return _prefetch; }
+    // 另一个主题已组合样式的总内存上限(字节)，包括之前预取及切换后保留的
+    // 结果，开启预取时在空闲时检查，超出部分被释放，达到上限后不再预取，
+    // 其余部分在切换时同步组合
+    void setPrefetchBudget(qsizetype bytes) { _prefetch_budget = bytes; }
+    [[nodiscard]] qsizetype prefetchBudget() const { return _prefetch_budget; }
+    // 取消进行中的预取，已完成的部分被丢弃
+    void cancelPrefetch();
+
+    // 监视外部样式文件，修改后只重新应用依赖该文件的组件
+    void setWatchEnabled(bool enable);
+    [[nodiscard]] bool isWatchEnabled() const { return _watcher != nullptr; }
+    // 依赖指定样式文件的组件
+    [[nodiscard]] QList<QWidget*> dependents(const QString& path) const;
 
 private:
     explicit StyleSheetManager();
     void init();
+    // 处理一个更新分片
+    void updateSlice();
+    // 获取或创建注册项
+    Item* insert(QWidget* widget);
+    // 从注册表中移除
+    void erase(QWidget* widget);
+    // 应用注册项的样式表部分
+    bool applyStyleSheet(Item* item, QWidget* widget, Theme theme);
+    // 标记槽位是否等待绘制时更新
+    void setLazy(quint32 slot, bool lazy);
+    // 记录可共享的样式
+    void share(StyleSheetBase* source);
+    // 样式不再被使用，从应用程序样式中移除
+    void unshare(StyleSheetBase* source);
+    // 生成并应用合并后的应用程序样式
+    void applyApplicationStyleSheet(Theme theme);
+    // 重新 polish 组件及其未注册的子组件
+    void repolish(QWidget* widget);
+    // 等待事件循环空闲后开始预取
+    void schedulePrefetch();
+    void startPrefetch();
+    // 记录与清除组件使用的样式及依赖的外部样式文件
+    void watch(Item* item, StyleSheetBase* source);
+    void unwatch(Item* item);
+    // 使组件的组合样式失效并重新应用，不可见组件等待绘制时更新
+    void reapply(const QSet<QWidget*>& widgets);
+    // 文件修改后等待一段时间再重新加载，编辑器保存时可能触发多次
+    void fileChanged(const QString& path);
+    void reloadFiles();
 
 protected:
-    static StyleSheetManager* Self;
-    QMap<QWidget*, Item> _widgets;
-
-}; // StyleSheetManager
+    // 所有已注册组件共用的事件过滤器
+    bool eventFilter(QObject* watched, QEvent* event) override;
+    // 自定义样式属性变化
+    void customStyleSheetChanged(QWidget* widget, const QByteArray& name);
+    // 延迟更新的组件在绘制前应用样式
+    void lazyApply(QWidget* widget);
 
-// 事件过滤器
-class CustomStyleSheetWatcher : public QObject
-{
-    Q_OBJECT;
+protected:
+    // 槽位，指向 _items 中的下标
+    struct Slot
+    {
+        quint32 index{0};
+        quint32 generation{0};
+    };
+    // 待更新的组件
+    struct Pending
+    {
+        Handle handle;
+        int rank{0};
+        qint64 area{0};
+    };
+    // 使用同一样式的组件，持有样式的引用
+    struct Dependents
+    {
+        QSharedPointer<StyleSheetBase> source;
+        QSet<QWidget*> widgets;
+    };
 
-public:
-    bool eventFilter(QObject* watched, QEvent* event) override;
-};
-class LineStyleSheetWatcher : public QObject
-{
-    Q_OBJECT;
+    static StyleSheetManager* Self;
+    // 稠密存储的注册项，删除时与末尾交换
+    QList<Item> _items;
+    // _items 下标 -> 槽位
+    QList<quint32> _item_slots;
+    // 槽位表与空闲槽位
+    QList<Slot> _slots;
+    QList<quint32> _free_slots;
+    // 组件 -> 槽位
+    QHash<QWidget*, quint32> _index;
+    // 等待绘制时更新的槽位
+    QBitArray _lazy;
+    qsizetype _lazy_count{0};
+    quint64 _applied{0};
+    quint64 _skipped{0};
+    quint64 _deferred{0};
+
+    // 分片更新，按优先级排序的可见组件
+    QTimer _slice_timer;
+    QList<Pending> _pending;
+    qsizetype _pending_pos{0};
+    // 首个分片必须完成的组件数(当前窗口内的可见组件)
+    qsizetype _pending_urgent{0};
+    Theme _pending_theme{Theme::LIGHT};
+    int _budget{0};
+
+    // 应用程序样式模式，styleKey -> 样式
+    bool _app_mode{false};
+    bool _app_dirty{false};
+    QMap<QString, QSharedPointer<StyleSheetBase>> _app_sources;
+    quint64 _app_hash{0};
+
+    ThemeStrategy _strategy{ThemeStrategy::StyleSheet};
+
+    // 预取，取消标记由工作线程共享
+    bool _prefetch{false};
+    qsizetype _prefetch_budget{8 * 1024 * 1024};
+    QMetaObject::Connection _prefetch_idle;
+    QSharedPointer<QAtomicInt> _prefetch_cancel;
+
+    // 样式 -> 使用的组件，样式从组合样式中移除后仍被持有，
+    // 最后一个组件注销前不会释放，地址不会被其他样式复用
+    QHash<StyleSheetBase*, Dependents> _source_index;
+    // 外部样式文件 -> 依赖的组件
+    QHash<QString, QSet<QWidget*>> _path_index;
+    QFileSystemWatcher* _watcher{nullptr};
+    QTimer _watch_timer;
+    QSet<QString> _changed_paths;
 
-public:
-    static const char* LINE_PROPERTY_KEY;
-    bool eventFilter(QObject* watched, QEvent* event) override;
-};
+}; // StyleSheetManager
 
-// 基础样式
-class StyleSheetBase
+// 基础样式，组合样式以 QSharedPointer 持有
+class StyleSheetBase : public QEnableSharedFromThis<StyleSheetBase>
 {
 public:
     StyleSheetBase() = default;
     virtual ~StyleSheetBase() = default;
     // 样式路径，必须实现
     virtual QString stylePath(Theme theme = Theme::LIGHT) = 0;
-    // 样式内容
+    // 样式内容，可包含 @name 主题变量
     virtual QString styleContent(Theme theme = Theme::LIGHT);
-    // 应用样式
-    void apply(QWidget* widget, Theme theme = Theme::LIGHT);
+    // 替换主题变量后的样式内容，每个主题的模板只在内容变化时解析
+    // styleContent 已替换变量时(如读取自 StyleSheetCache)应直接返回
+    virtual QString themeContent(Theme theme);
+    // 共享样式的标识，非空时可合并到应用程序样式中
+    // 合并后样式作用于整个应用程序，选择器必须已限定到组件类
+    // (如 QLW--Alert)，否则应返回空，由组件各自设置
+    virtual QString styleKey() const { return ""; }
+    // themeContent 是否可以在预取线程中调用
+    virtual bool isThreadSafe() const { return false; }
+    // stylePath 是否可能指向可修改的外部文件，否则不再监视
+    virtual bool isExternal() const { return true; }
+    // 应用样式，未指定主题时使用配置中的当前主题
+    void apply(QWidget* widget, Theme theme = Config::instance()->getTheme());
+
+    // 已由 QSharedPointer 管理时共享引用，否则接管所有权
+    static QSharedPointer<StyleSheetBase> adopt(StyleSheetBase* source);
+
+private:
+    // 最近一次解析的内容与生成结果
+    struct Template
+    {
+        QString source;
+        StyleTemplate tmpl;
+        quint64 token_generation{0};
+        QString content;
+    };
+    // 首次使用时创建
+    std::unique_ptr<std::array<Template, ThemeCount>> _templates;
 
 }; // class StyleSheetBase
 
 class StyleSheetCompose : public StyleSheetBase
 {
 public:
+    // 预取快照，在 GUI 线程中创建，在工作线程中组合
+    struct Snapshot
+    {
+        Theme theme{Theme::LIGHT};
+        bool local{false};
+        quint64 generation{0};
+        quint64 cache_generation{0};
+        quint64 token_generation{0};
+        // 可在工作线程中读取的样式，为空时使用已读取的内容
+        QList<QPair<QSharedPointer<StyleSheetBase>, QString>> parts;
+    };
+
+public:
+    // 接管未被共享的样式，共享样式(如 LineStyleSheet::instance)只增加引用
     StyleSheetCompose(std::initializer_list<StyleSheetBase*> list);
-    ~StyleSheetCompose() override;
+    ~StyleSheetCompose() override = default;
     QString stylePath(Theme theme = Theme::LIGHT) override { return ""; }
     QString styleContent(Theme theme = Theme::LIGHT) override;
+    QString themeContent(Theme theme) override { return styleContent(theme); }
+    bool isExternal() const override { return false; }
+    // 只组合不可共享(styleKey 为空)的样式
+    QString localContent(Theme theme = Theme::LIGHT);
+    // 同时包含所有主题、以 qlwTheme 属性限定的样式
+    QString scopedContent(bool local = false);
+    // 组合结果的哈希，与 styleContent/localContent/scopedContent 对应
+    quint64 contentHash(Theme theme, bool local = false);
+    quint64 scopedHash(bool local = false);
+    // 收集可共享的样式
+    void sharedSources(QList<StyleSheetBase*>& list) const;
+
+    // 组合结果是否仍然有效
+    [[nodiscard]] bool isComposed(Theme theme, bool local = false) const;
+    // 创建预取快照，不可在工作线程中读取的样式在此处读取
+    Snapshot snapshot(Theme theme, bool local = false);
+    // 在工作线程中组合快照
+    static QString render(const Snapshot& snapshot);
+    // 写入预取结果，快照创建后样式已变化时丢弃
+    bool prime(const Snapshot& snapshot, const QString& content, quint64 hash);
 
     void add(StyleSheetBase* source);
+    // 移除并释放引用，需要继续使用时应以 QSharedPointer 管理，
+    // 通过 StyleSheetManager 注册的样式在组件注销前仍由其持有
     void remove(StyleSheetBase* source);
+    // 已组合样式的字节数
+    [[nodiscard]] qsizetype composedBytes() const;
+    [[nodiscard]] qsizetype composedBytes(Theme theme, bool local) const;
+    // 释放指定主题的组合结果，下次使用时重新组合
+    void release(Theme theme);
+    // 使已组合的样式失效
+    void invalidate() { ++_generation; }
+    [[nodiscard]] quint64 generation() const { return _generation; }
 
 private:
-    QList<StyleSheetBase*> _list;
+    // 单个主题的组合结果
+    struct Composed
+    {
+        quint64 generation{0};
+        quint64 cache_generation{0};
+        quint64 token_generation{0};
+        quint64 hash{0};
+        QString content;
+    };
+
+    const Composed& compose(Composed& composed, Theme theme, bool local);
+    const Composed& scoped(bool local);
+    [[nodiscard]] bool isValid(const Composed& composed) const;
+    void stamp(Composed& composed, const QString& content) const;
+
+private:
+    QList<QSharedPointer<StyleSheetBase>> _list;
+    quint64 _generation{1};
+    std::array<Composed, ThemeCount> _composed;
+    std::array<Composed, ThemeCount> _local;
+    std::array<Composed, 2> _scoped;
 };
 
+// 样式文件缓存，文件只读取并编译一次，按主题分槽保存生成结果
+// content 可在预取线程中调用
+class StyleSheetCache
+{
+public:
+    ~StyleSheetCache() = default;
+    static StyleSheetCache* instance();
+    // 获取样式文件内容，命中缓存时不再读取文件
+    QString content(const QString& path, Theme theme = Theme::LIGHT);
+    // 使指定文件在所有主题下的缓存失效，不改变缓存版本，
+    // 其他组合样式保持有效，读取了该文件的组合样式需由调用者使之失效
+    // (如 StyleSheetManager::dependents(path))
+    void invalidate(const QString& path);
+    // 使指定主题的缓存失效
+    void invalidate(Theme theme);
+    // 清空缓存
+    void clear();
+    // 缓存版本，按主题失效或清空时递增
+    [[nodiscard]] quint64 generation() const
+    {
+        return _generation.loadAcquire();
+    }
+
+private:
+    StyleSheetCache() = default;
+
+private:
+    static StyleSheetCache* Self;
+
+    QMutex _mutex;
+    // 文件路径 -> 编译后的模板
+    QHash<QString, StyleTemplate> _templates;
+    // 各主题下生成的样式
+    std::array<QHash<QString, QString>, ThemeCount> _slots;
+    QAtomicInteger<quint64> _generation{1};
+    quint64 _token_generation{0};
+
+}; // class StyleSheetCache
+
 // 内置样式
 enum class LineStyleSheetEnum
 {
     alert,
 }; // enum LineStyleSheetEnum
 
+#if defined(QLW_EMBEDDED_QSS)
+// 构建时嵌入的内置样式，按 LineStyleSheetEnum 与主题(light, dark)索引
+inline constexpr auto LineStyleSheetTable = [] {
+    constexpr auto count = magic_enum::enum_count<LineStyleSheetEnum>();
+    std::array<std::array<std::u16string_view, 2>, count> table{};
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto name =
+            magic_enum::enum_name(magic_enum::enum_value<LineStyleSheetEnum>(i));
+        for (const auto& it : Embedded::QssTable) {
+            if (it.name == name) {
+                table[i] = it.content;
+            }
+        }
+    }
+    return table;
+}();
+#endif
+
 template <LineStyleSheetEnum E> class LineStyleSheet : public StyleSheetBase
 {
 public:
@@ -123,13 +551,50 @@ public:
 
     QString stylePath(Theme theme = Theme::LIGHT) override
     {
-        theme = Config::instance()->getTheme();
         const char* t = (theme == Theme::LIGHT) ? "light" : "dark";
         auto path = magic_enum::enum_name(E);
         return QString::fromStdString(
             std::format(":/qlw/qss/{}/{}.qss", t, path));
     }
+    QString styleContent(Theme theme = Theme::LIGHT) override
+    {
+#if defined(QLW_EMBEDDED_QSS)
+        constexpr auto index = magic_enum::enum_index(E).value();
+        constexpr auto npos = std::u16string_view::npos;
+        // 含变量的内置样式交给 StyleSheetCache，模板只解析一次
+        constexpr std::array<bool, 2> tokens{
+            LineStyleSheetTable[index][0].find(u'@') != npos,
+            LineStyleSheetTable[index][1].find(u'@') != npos,
+        };
+        const auto i = theme == Theme::LIGHT ? 0 : 1;
+        const auto qss = LineStyleSheetTable[index][i];
+        if (!qss.empty() && !tokens[i]) {
+            // 直接引用只读数据，无需读取文件与分配内存
+            return QString::fromRawData(
+                reinterpret_cast<const QChar*>(qss.data()),
+                qsizetype(qss.size()));
+        }
+#endif
+        return StyleSheetCache::instance()->content(stylePath(theme), theme);
+    }
+    // 内容中的变量已替换
+    QString themeContent(Theme theme) override { return styleContent(theme); }
+    QString styleKey() const override
+    {
+        auto name = magic_enum::enum_name(E);
+        return "qlw:" +
+               QString::fromLatin1(name.data(), qsizetype(name.size()));
+    }
+    bool isThreadSafe() const override { return true; }
+    // 样式位于资源文件中
+    bool isExternal() const override { return false; }
 
+    // 进程内共享的不可变实例，组合样式只持有引用
+    static LineStyleSheet<E>* instance()
+    {
+        static const auto self = QSharedPointer<LineStyleSheet<E>>::create();
+        return self.get();
+    }
     static LineStyleSheet<E>* create() { return new LineStyleSheet<E>(); }
 };
 
@@ -144,6 +609,12 @@ public:
     ~FileStyleSheet() override = default;
 
     QString stylePath(Theme theme = Theme::LIGHT) override { return _path; }
+    QString styleContent(Theme theme = Theme::LIGHT) override
+    {
+        return StyleSheetCache::instance()->content(_path, theme);
+    }
+    QString themeContent(Theme theme) override { return styleContent(theme); }
+    bool isThreadSafe() const override { return true; }
 
 private:
     QString _path;
@@ -160,6 +631,7 @@ public:
     ~CustomStyleSheet() override = default;
 
     QString stylePath(Theme theme = Theme::LIGHT) override { return ""; }
+    bool isExternal() const override { return false; }
 
     QString styleContent(Theme theme = Theme::LIGHT) override;
 
@@ -197,21 +669,39 @@ private:
 
 // 从文件获取样式内容
 QString getStyleSheetFromFile(const QString& path);
+// 计算样式内容的 64 位哈希
+quint64 getStyleSheetHash(const QString& qss);
+// 应用主题颜色，替换样式中的 @name 变量，每次调用都会重新解析
+QString ApplyThemeColor(const QString& qss, Theme theme);
+// 为样式中的每个选择器加上 [qlwTheme="<theme>"] 限定
+QString ScopeThemeStyleSheet(const QString& qss, Theme theme);
+// 以下接口未指定主题时均使用配置中的当前主题
+
 // 从 StyleSheet 获取主题样式内容
-QString getThemeStyleSheet(StyleSheetBase* source, Theme theme = Theme::LIGHT);
+QString getThemeStyleSheet(StyleSheetBase* source,
+                           Theme theme = Config::instance()->getTheme());
 // 从文件路径获取主题样式内容
-QString getThemeStyleSheet(const QString& path, Theme theme = Theme::LIGHT);
+QString getThemeStyleSheet(const QString& path,
+                           Theme theme = Config::instance()->getTheme());
 // 为组件设置主题样式
 void setThemeStyleSheet(QWidget* widget, StyleSheetBase* source,
-                        Theme theme = Theme::LIGHT, bool reg = true);
+                        Theme theme = Config::instance()->getTheme(),
+                        bool reg = true);
+// 为组件设置主题后端，不使用样式表
+void setThemeBackend(QWidget* widget,
+                     const QSharedPointer<ThemeBackend>& backend,
+                     Theme theme = Config::instance()->getTheme(),
+                     bool reg = true);
 // 为组件设置自定义样式
 void setCustomStyleSheet(QWidget* widget, const QString& light_qss,
                          const QString& dark_qss);
 // 为组件添加主题样式
 void addThemeStyleSheet(QWidget* widget, StyleSheetBase* source,
-                        Theme theme = Theme::LIGHT, bool reg = true);
+                        Theme theme = Config::instance()->getTheme(),
+                        bool reg = true);
 void addThemeStyleSheet(QWidget* widget, const QString& path,
-                        Theme theme = Theme::LIGHT, bool reg = true);
+                        Theme theme = Config::instance()->getTheme(),
+                        bool reg = true);
 
 // 更新样式
 void updateStyleSheet(bool lazy = false);
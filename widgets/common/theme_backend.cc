@@ -0,0 +1,62 @@
+#include "theme_backend.h"
+
+namespace QLW
+{
+
+PaletteStyle::PaletteStyle()
+{
+    QPalette light;
+    light.setColor(QPalette::Window, QColor(0xf0, 0xf0, 0xf0));
+    light.setColor(QPalette::WindowText, QColor(23, 24, 26));
+    light.setColor(QPalette::Base, QColor(0xff, 0xff, 0xff));
+    light.setColor(QPalette::AlternateBase, QColor(0xf5, 0xf5, 0xf5));
+    light.setColor(QPalette::Text, QColor(23, 24, 26));
+    light.setColor(QPalette::Button, QColor(0xf5, 0xf5, 0xf5));
+    light.setColor(QPalette::ButtonText, QColor(0x23, 0x27, 0x30));
+    light.setColor(QPalette::PlaceholderText, QColor(23, 24, 26, 128));
+    light.setColor(QPalette::Highlight, QColor(0x16, 0x77, 0xff));
+    light.setColor(QPalette::HighlightedText, QColor(0xff, 0xff, 0xff));
+
+    QPalette dark;
+    dark.setColor(QPalette::Window, QColor(23, 24, 26));
+    dark.setColor(QPalette::WindowText, QColor(235, 234, 236));
+    dark.setColor(QPalette::Base, QColor(0x23, 0x27, 0x30));
+    dark.setColor(QPalette::AlternateBase, QColor(31, 32, 35));
+    dark.setColor(QPalette::Text, QColor(235, 234, 236));
+    dark.setColor(QPalette::Button, QColor(0x23, 0x27, 0x30));
+    dark.setColor(QPalette::ButtonText, QColor(0xf5, 0xf5, 0xf5));
+    dark.setColor(QPalette::PlaceholderText, QColor(235, 234, 236, 128));
+    dark.setColor(QPalette::Highlight, QColor(0x3c, 0x89, 0xe8));
+    dark.setColor(QPalette::HighlightedText, QColor(0xff, 0xff, 0xff));
+
+    _palettes[Theme::LIGHT] = light;
+    _palettes[Theme::DARK] = dark;
+    _palettes[Theme::AUTO] = light;
+}
+
+void PaletteStyle::setPalette(Theme theme, const QPalette& palette)
+{
+    _palettes[theme] = palette;
+}
+
+QPalette PaletteStyle::palette(Theme theme) const { return _palettes[theme]; }
+
+void PaletteStyle::setFont(Theme theme, const QFont& font)
+{
+    _fonts[theme] = font;
+}
+
+std::optional<QFont> PaletteStyle::font(Theme theme) const
+{
+    return _fonts[theme];
+}
+
+void PaletteStyle::applyTheme(QWidget* widget, Theme theme)
+{
+    widget->setPalette(_palettes[theme]);
+    if (_fonts[theme].has_value()) {
+        widget->setFont(*_fonts[theme]);
+    }
+}
+
+} // namespace QLW
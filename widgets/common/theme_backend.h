@@ -0,0 +1,51 @@
+/**
+ * @author: Ticks
+ * @email: ticks.cc@gmail.com
+ */
+
+#pragma once
+
+#include <QFont>
+#include <QPalette>
+#include <QWidget>
+#include <array>
+#include <optional>
+
+#include "config.h"
+
+namespace QLW
+{
+
+// 主题后端，不经过样式表直接修改组件外观
+class ThemeBackend
+{
+public:
+    ThemeBackend() = default;
+    virtual ~ThemeBackend() = default;
+    // 为组件应用主题
+    virtual void applyTheme(QWidget* widget, Theme theme) = 0;
+
+}; // class ThemeBackend
+
+// 基于 QPalette 与字体的主题，适用于不需要样式表的简单组件
+class PaletteStyle : public ThemeBackend
+{
+public:
+    // 使用默认的亮色与暗色调色板
+    PaletteStyle();
+    ~PaletteStyle() override = default;
+
+    void setPalette(Theme theme, const QPalette& palette);
+    [[nodiscard]] QPalette palette(Theme theme) const;
+    void setFont(Theme theme, const QFont& font);
+    [[nodiscard]] std::optional<QFont> font(Theme theme) const;
+
+    void applyTheme(QWidget* widget, Theme theme) override;
+
+private:
+    std::array<QPalette, ThemeCount> _palettes;
+    std::array<std::optional<QFont>, ThemeCount> _fonts;
+
+}; // class PaletteStyle
+
+} // namespace QLW
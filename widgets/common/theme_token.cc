@@ -0,0 +1,169 @@
+#include "theme_token.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+namespace QLW
+{
+
+/*------------------- ThemeTokens -------------------*/
+
+ThemeTokens* ThemeTokens::Self = nullptr;
+
+ThemeTokens::ThemeTokens()
+{
+    // 默认变量
+    setToken("background", "#f0f0f0", "rgb(23, 24, 26)");
+    setToken("text", "rgb(23, 24, 26)", "rgb(235, 234, 236)");
+    setToken("text-secondary", "rgba(23, 24, 26, 0.9)",
+             "rgba(235, 234, 236, 0.9)");
+    setToken("border", "rgba(23, 25, 26, 0.3)", "rgba(235, 235, 235, 0.3)");
+    setToken("accent", "#1677ff", "#3c89e8");
+}
+
+ThemeTokens* ThemeTokens::instance()
+{
+    if (ThemeTokens::Self == nullptr) {
+        static QMutex mutex;
+        QMutexLocker locker{&mutex};
+
+        if (ThemeTokens::Self == nullptr) {
+            ThemeTokens::Self = new ThemeTokens();
+        }
+    }
+    return ThemeTokens::Self;
+}
+
+void ThemeTokens::setToken(const QString& name, Theme theme,
+                           const QString& value)
+{
+    QWriteLocker locker{&_lock};
+    _values[this->insert(name)][theme] = value;
+    _generation.fetchAndAddRelease(1);
+}
+
+void ThemeTokens::setToken(const QString& name, const QString& light,
+                           const QString& dark)
+{
+    QWriteLocker locker{&_lock};
+    auto& values = _values[this->insert(name)];
+    values[Theme::LIGHT] = light;
+    values[Theme::DARK] = dark;
+    _generation.fetchAndAddRelease(1);
+}
+
+QString ThemeTokens::token(const QString& name, Theme theme) const
+{
+    QReadLocker locker{&_lock};
+    auto it = _ids.constFind(name);
+    if (it == _ids.constEnd()) {
+        return "";
+    }
+    return _values[it.value()][theme];
+}
+
+QString ThemeTokens::value(int id, Theme theme) const
+{
+    QReadLocker locker{&_lock};
+    return _values[id][theme];
+}
+
+int ThemeTokens::id(const QString& name)
+{
+    {
+        QReadLocker locker{&_lock};
+        auto it = _ids.constFind(name);
+        if (it != _ids.constEnd()) {
+            return it.value();
+        }
+    }
+    QWriteLocker locker{&_lock};
+    return this->insert(name);
+}
+
+int ThemeTokens::insert(const QString& name)
+{
+    auto it = _ids.constFind(name);
+    if (it != _ids.constEnd()) {
+        return it.value();
+    }
+    auto id = int(_values.size());
+    _values.emplaceBack();
+    _ids.insert(name, id);
+    return id;
+}
+
+/*------------------- StyleTemplate -------------------*/
+
+static bool IsTokenChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == '-' || c == '_';
+}
+
+StyleTemplate::StyleTemplate(const QString& qss)
+    : _source(qss)
+{
+    auto tokens = ThemeTokens::instance();
+    const auto size = qss.size();
+    qsizetype literal = 0;
+    auto pos = qss.indexOf('@');
+    while (pos >= 0) {
+        auto end = pos + 1;
+        while (end < size && IsTokenChar(qss[end])) {
+            ++end;
+        }
+        if (end > pos + 1) {
+            if (pos > literal) {
+                _segments.append(Segment{literal, pos - literal, -1});
+            }
+            auto id = tokens->id(qss.mid(pos + 1, end - pos - 1));
+            _segments.append(Segment{pos, end - pos, id});
+            _has_tokens = true;
+            literal = end;
+        }
+        pos = qss.indexOf('@', end);
+    }
+    if (literal < size) {
+        _segments.append(Segment{literal, size - literal, -1});
+    }
+}
+
+QString StyleTemplate::render(Theme theme) const
+{
+    if (!_has_tokens) {
+        return _source;
+    }
+
+    // 先计算长度，一次分配后顺序拷贝
+    auto tokens = ThemeTokens::instance();
+    QReadLocker locker{&tokens->_lock};
+    const auto& values = tokens->_values;
+    qsizetype size = 0;
+    for (const auto& it : _segments) {
+        if (it.token >= 0 && !values[it.token][theme].isNull()) {
+            size += values[it.token][theme].size();
+        } else {
+            size += it.length;
+        }
+    }
+
+    QString content;
+    content.reserve(size);
+    const QStringView source{_source};
+    for (const auto& it : _segments) {
+        if (it.token >= 0) {
+            const auto& value = values[it.token][theme];
+            if (!value.isNull()) {
+                content.append(value);
+                continue;
+            }
+        }
+        // 未定义的变量原样保留
+        content.append(source.mid(it.offset, it.length));
+    }
+    return content;
+}
+
+} // namespace QLW
@@ -0,0 +1,90 @@
+/**
+ * @author: Ticks
+ * @email: ticks.cc@gmail.com
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QAtomicInteger>
+#include <QList>
+#include <QReadWriteLock>
+#include <QString>
+#include <array>
+
+#include "config.h"
+
+namespace QLW
+{
+
+// 主题变量，在样式中以 @name 引用，如 @accent、@text-secondary
+// 可在预取线程中读取，修改只在 GUI 线程中进行
+class ThemeTokens
+{
+    friend class StyleTemplate;
+
+public:
+    ~ThemeTokens() = default;
+    static ThemeTokens* instance();
+
+    // 设置变量在某个主题下的值，name 不含 '@'
+    void setToken(const QString& name, Theme theme, const QString& value);
+    void setToken(const QString& name, const QString& light,
+                  const QString& dark);
+    // 获取变量值，未定义时返回空字符串
+    [[nodiscard]] QString token(const QString& name, Theme theme) const;
+
+    // 变量编号，不存在时分配新编号
+    int id(const QString& name);
+    // 按编号获取变量值，未定义时返回 null 字符串
+    [[nodiscard]] QString value(int id, Theme theme) const;
+    // 变量版本，每次修改时递增
+    [[nodiscard]] quint64 generation() const
+    {
+        return _generation.loadAcquire();
+    }
+
+private:
+    ThemeTokens();
+    // 调用者需持有写锁
+    int insert(const QString& name);
+
+private:
+    static ThemeTokens* Self;
+
+    mutable QReadWriteLock _lock;
+    QHash<QString, int> _ids;
+    QList<std::array<QString, ThemeCount>> _values;
+    QAtomicInteger<quint64> _generation{1};
+
+}; // class ThemeTokens
+
+// 预编译的样式模板，由文本片段与变量片段组成
+class StyleTemplate
+{
+public:
+    StyleTemplate() = default;
+    explicit StyleTemplate(const QString& qss);
+    ~StyleTemplate() = default;
+
+    // 是否包含变量
+    [[nodiscard]] bool hasTokens() const { return _has_tokens; }
+    // 生成指定主题下的样式
+    [[nodiscard]] QString render(Theme theme) const;
+
+private:
+    // 片段，token 小于 0 时为文本
+    struct Segment
+    {
+        qsizetype offset{0};
+        qsizetype length{0};
+        int token{-1};
+    };
+
+    QString _source;
+    QList<Segment> _segments;
+    bool _has_tokens{false};
+
+}; // class StyleTemplate
+
+} // namespace QLW
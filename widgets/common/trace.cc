@@ -0,0 +1,145 @@
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+
+#include "3rdparty/json/nlohmann_json.h"
+
+namespace QLW
+{
+
+/*------------------- Tracer -------------------*/
+
+Tracer* Tracer::Self = nullptr;
+std::atomic_bool Tracer::Enabled{false};
+
+Tracer::Tracer()
+{
+    _clock.start();
+}
+
+Tracer* Tracer::instance()
+{
+    if (Tracer::Self == nullptr) {
+        static QMutex mutex;
+        QMutexLocker locker{&mutex};
+
+        if (Tracer::Self == nullptr) {
+            Tracer::Self = new Tracer();
+        }
+    }
+    return Tracer::Self;
+}
+
+void Tracer::setEnabled(bool enable)
+{
+    Enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Tracer::setCapacity(qsizetype capacity)
+{
+    QMutexLocker locker{&_mutex};
+    _capacity = capacity;
+}
+
+qsizetype Tracer::capacity() const
+{
+    QMutexLocker locker{&_mutex};
+    return _capacity;
+}
+
+quint64 Tracer::dropped() const
+{
+    QMutexLocker locker{&_mutex};
+    return _dropped;
+}
+
+void Tracer::record(Event event)
+{
+    QMutexLocker locker{&_mutex};
+    if (_events.size() >= _capacity) {
+        ++_dropped;
+        return;
+    }
+    _events.append(std::move(event));
+}
+
+QList<Tracer::Event> Tracer::events() const
+{
+    QMutexLocker locker{&_mutex};
+    return _events;
+}
+
+void Tracer::clear()
+{
+    QMutexLocker locker{&_mutex};
+    _events.clear();
+    _dropped = 0;
+}
+
+QByteArray Tracer::toJson() const
+{
+    // 完整事件(ph = X)，时间单位为微秒
+    const auto pid = QCoreApplication::applicationPid();
+    auto list = nlohmann::json::array();
+    for (const auto& it : this->events()) {
+        nlohmann::json event = {
+            {"name", it.name},
+            {"cat",  "qlw"  },
+            {"ph",   "X"    },
+            {"ts",   double(it.begin) / 1000.0},
+            {"dur",  double(it.duration) / 1000.0},
+            {"pid",  pid    },
+            {"tid",  quint64(it.thread)},
+        };
+        if (!it.widget_class.isEmpty()) {
+            event["args"] = {
+                {"class",      it.widget_class.toStdString()},
+                {"objectName", it.object_name.toStdString() },
+            };
+        }
+        list.push_back(std::move(event));
+    }
+    nlohmann::json doc = {
+        {"traceEvents",     std::move(list)},
+        {"displayTimeUnit", "ms"           },
+    };
+    const auto content = doc.dump();
+    return QByteArray(content.data(), qsizetype(content.size()));
+}
+
+bool Tracer::save(const QString& path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    file.write(this->toJson());
+    return file.commit();
+}
+
+/*------------------- TraceScope -------------------*/
+
+void TraceScope::begin(const char* name, const QWidget* widget)
+{
+    _active = true;
+    _event.name = name;
+    _event.thread = quintptr(QThread::currentThreadId());
+    // 组件可能在作用域内被销毁，先记录名称
+    if (widget != nullptr) {
+        _event.widget_class = widget->metaObject()->className();
+        _event.object_name = widget->objectName();
+    }
+    _event.begin = Tracer::instance()->now();
+}
+
+void TraceScope::end()
+{
+    auto tracer = Tracer::instance();
+    _event.duration = tracer->now() - _event.begin;
+    tracer->record(std::move(_event));
+}
+
+} // namespace QLW
@@ -0,0 +1,102 @@
+/**
+ * @author: Ticks
+ * @email: ticks.cc@gmail.com
+ */
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QWidget>
+#include <atomic>
+
+namespace QLW
+{
+
+// 追踪事件记录，导出为 Chrome trace_event JSON，可在 Perfetto 中查看
+class Tracer
+{
+public:
+    // 一个完整阶段，时间单位为纳秒
+    struct Event
+    {
+        const char* name{nullptr};
+        qint64 begin{0};
+        qint64 duration{0};
+        quintptr thread{0};
+        QString widget_class;
+        QString object_name;
+    };
+
+public:
+    ~Tracer() = default;
+    static Tracer* instance();
+
+    // 运行时开关，关闭时追踪点只有一次原子读取
+    static bool isEnabled() { return Enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enable);
+    // 最多保存的事件数，超出后丢弃新事件
+    void setCapacity(qsizetype capacity);
+    [[nodiscard]] qsizetype capacity() const;
+    // 因超出容量被丢弃的事件数
+    [[nodiscard]] quint64 dropped() const;
+
+    // 追踪开始后经过的纳秒数
+    [[nodiscard]] qint64 now() const { return _clock.nsecsElapsed(); }
+    void record(Event event);
+    [[nodiscard]] QList<Event> events() const;
+    void clear();
+
+    // 导出为 trace_event JSON
+    [[nodiscard]] QByteArray toJson() const;
+    bool save(const QString& path) const;
+
+private:
+    Tracer();
+
+private:
+    static Tracer* Self;
+    static std::atomic_bool Enabled;
+
+    QElapsedTimer _clock;
+    mutable QMutex _mutex;
+    QList<Event> _events;
+    qsizetype _capacity{1 << 20};
+    quint64 _dropped{0};
+
+}; // class Tracer
+
+// 作用域追踪，析构时记录阶段耗时
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name, const QWidget* widget = nullptr)
+    {
+        if (Tracer::isEnabled()) {
+            this->begin(name, widget);
+        }
+    }
+    ~TraceScope()
+    {
+        if (_active) {
+            this->end();
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    void begin(const char* name, const QWidget* widget);
+    void end();
+
+private:
+    bool _active{false};
+    Tracer::Event _event;
+};
+
+} // namespace QLW
+
+// 追踪当前作用域，可选参数为关联的组件
+#define QLW_TRACE_SCOPE(...) ::QLW::TraceScope qlw_trace_scope_{__VA_ARGS__}
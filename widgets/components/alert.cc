@@ -85,7 +85,7 @@ void AlertPrivate::init()
         [this](const QString& content) { this->ui_content->setText(content); });
     QObject::connect(ui_close, &QPushButton::clicked, [q] { q->close(); });
 
-    LineStyleSheet<LineStyleSheetEnum::alert>::create()->apply(q);
+    LineStyleSheet<LineStyleSheetEnum::alert>::instance()->apply(q, theme);
 }
 
 /*-------------------------------------*/
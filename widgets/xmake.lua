@@ -1,3 +1,139 @@
+-- 内置样式编译: 压缩 res/qss/<theme>/<name>.qss 并生成 constexpr 样式表
+rule("qlw.qss")
+    on_config(function (target)
+        local gendir = path.join(target:autogendir(), "rules", "qlw", "qss")
+        os.mkdir(gendir)
+        target:add("includedirs", gendir, { public = true })
+        target:add("defines", "QLW_EMBEDDED_QSS", { public = true })
+    end)
+    before_build(function (target)
+        -- 去除注释与多余空白，引号内的内容保持不变，
+        -- ":" 两侧的空白只在声明块内去除，选择器中的 "QWidget :hover" 不受影响
+        local function minify(content)
+            local out = {}
+            local depth = 0
+            local quote = nil
+            local space = false
+            local function separator(c)
+                return c:find("^[{};,]") ~= nil or (c == ":" and depth > 0)
+            end
+            local i = 1
+            while i <= #content do
+                local c = content:sub(i, i)
+                if quote then
+                    table.insert(out, c)
+                    if c == "\\" and i < #content then
+                        i = i + 1
+                        table.insert(out, content:sub(i, i))
+                    elseif c == quote then
+                        quote = nil
+                    end
+                    i = i + 1
+                elseif c == "/" and content:sub(i + 1, i + 1) == "*" then
+                    local stop = content:find("*/", i + 2, true)
+                    i = stop and stop + 2 or #content + 1
+                elseif c:find("^%s") then
+                    space = true
+                    i = i + 1
+                else
+                    if space and #out > 0 and not separator(out[#out]) and not separator(c) then
+                        table.insert(out, " ")
+                    end
+                    space = false
+                    if c == "\"" or c == "'" then
+                        quote = c
+                    elseif c == "{" then
+                        depth = depth + 1
+                    elseif c == "}" then
+                        depth = math.max(depth - 1, 0)
+                        if out[#out] == ";" then
+                            table.remove(out)
+                        end
+                    end
+                    table.insert(out, c)
+                    i = i + 1
+                end
+            end
+            return table.concat(out)
+        end
+        -- 转为 u"" 字符串，按 ASCII 边界分段以避免超出编译器字面量长度限制，
+        -- 先分段再转义，转义序列不会被拆到两段中
+        local function literal(content)
+            local parts = {}
+            local start = 1
+            while start <= #content do
+                local stop = math.min(start + 2000, #content)
+                while stop < #content and content:byte(stop + 1) >= 0x80 do
+                    stop = stop + 1
+                end
+                local part = content:sub(start, stop)
+                part = part:gsub("\\", "\\\\"):gsub("\"", "\\\"")
+                table.insert(parts, "u\"" .. part .. "\"")
+                start = stop + 1
+            end
+            if #parts == 0 then
+                return "u\"\""
+            end
+            return table.concat(parts, "\n          ")
+        end
+
+        local qssdir = path.join(target:scriptdir(), "res", "qss")
+        local names = {}
+        local styles = {}
+        for _, file in ipairs(os.files(path.join(qssdir, "*", "*.qss"))) do
+            local theme = path.filename(path.directory(file))
+            local name = path.basename(file)
+            if not styles[name] then
+                styles[name] = {}
+                table.insert(names, name)
+            end
+            styles[name][theme] = minify(io.readfile(file))
+        end
+        table.sort(names)
+
+        local lines = {
+            "// Generated from res/qss by the qlw.qss rule in widgets/xmake.lua, do not edit.",
+            "#pragma once",
+            "",
+            "#include <array>",
+            "#include <string_view>",
+            "",
+            "namespace QLW::Embedded",
+            "{",
+            "",
+            "struct Qss",
+            "{",
+            "    std::string_view name;",
+            "    // light, dark",
+            "    std::array<std::u16string_view, 2> content;",
+            "};",
+            "",
+            "inline constexpr std::array<Qss, " .. #names .. "> QssTable{{",
+        }
+        for _, name in ipairs(names) do
+            table.insert(lines, "    {\"" .. name .. "\",")
+            table.insert(lines, "     {" .. literal(styles[name]["light"] or "") .. ",")
+            table.insert(lines, "      " .. literal(styles[name]["dark"] or "") .. "}},")
+        end
+        table.insert(lines, "}};")
+        table.insert(lines, "")
+        table.insert(lines, "} // namespace QLW::Embedded")
+        table.insert(lines, "")
+
+        local content = table.concat(lines, "\n")
+        local gendir = path.join(target:autogendir(), "rules", "qlw", "qss")
+        local header = path.join(gendir, "qlw_qss_table.h")
+        if not os.isfile(header) or io.readfile(header) ~= content then
+            io.writefile(header, content)
+        end
+    end)
+rule_end()
+
+option("qlw_stats")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Collect StyleSheetManager statistics (QLW_ENABLE_STATS)")
+option_end()
 
 -- Widgets Library
 target("qt_line_widgets_static")
@@ -5,9 +141,12 @@ target("qt_line_widgets_static")
     set_languages("c++20")
     add_cxxflags("/source-charset:utf-8", { tools = {"cl", "win32_msvc"}}, {force = true})
     add_rules("qt.static")
+    add_rules("qlw.qss")
+    if has_config("qlw_stats") then
+        add_defines("QLW_ENABLE_STATS", { public = true })
+    end
     add_includedirs(".", { public = true })
     add_files("res/resource.qrc")
     add_files("./common/**.h", "./common/**.cc")
     add_files("./components/**.h", "./components/**.cc")
     add_frameworks("QtGui", "QtCore", "QtWidgets", "QtSvg")
--- todo
\ No newline at end of file
@@ -9,4 +9,4 @@ set_warnings("all")
 add_rules("mode.release", "mode.debug")
 
 -- Include SubTargets
-includes("widgets", "examples")
\ No newline at end of file
+includes("widgets", "examples", "bench")
\ No newline at end of file